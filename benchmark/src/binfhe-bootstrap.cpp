@@ -0,0 +1,355 @@
+// @file binfhe-bootstrap.cpp - Benchmarks of FHEW bootstrapping and key switching
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+
+/*
+ * Benchmarks of the sign evaluation used by DiNN, the FHEW bootstrapping and
+ * gate evaluation and their building blocks, for every predefined parameter
+ * set and the default DiNN parameters. Run with
+ * --benchmark_filter=<regex> to select parameter sets; the keys of a
+ * parameter set are only generated when one of its benchmarks runs.
+ */
+
+#define _USE_MATH_DEFINES
+#include "benchmark/benchmark.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cryptocontext.h"
+#include "math/discreteuniformgenerator.h"
+
+using namespace lbcrypto;
+
+namespace {
+
+// plaintext modulus of the sign evaluation: the one of DiNN for its own
+// parameters and a binary message space for the FHEW parameter sets
+const LWEPlaintextModulus DINN_P = 512;
+const LWEPlaintextModulus BINFHE_P = 4;
+
+struct ParamSet {
+  const char *name;
+  BINFHEPARAMSET set;
+  bool dinn;  // Generate_Default_params instead of set
+};
+
+const ParamSet PARAM_SETS[] = {{"DINN", TOY, true},
+                               {"TOY", TOY, false},
+                               {"MEDIUM", MEDIUM, false},
+                               {"STD128_AP", STD128_AP, false},
+                               {"STD128_APOPT", STD128_APOPT, false},
+                               {"STD128", STD128, false},
+                               {"STD128_OPT", STD128_OPT, false},
+                               {"STD192", STD192, false},
+                               {"STD192_OPT", STD192_OPT, false},
+                               {"STD256", STD256, false},
+                               {"STD256_OPT", STD256_OPT, false},
+                               {"STD128Q", STD128Q, false},
+                               {"STD128Q_OPT", STD128Q_OPT, false},
+                               {"STD192Q", STD192Q, false},
+                               {"STD192Q_OPT", STD192Q_OPT, false},
+                               {"STD256Q", STD256Q, false},
+                               {"STD256Q_OPT", STD256Q_OPT, false},
+                               {"SIGNED_MOD_TEST", SIGNED_MOD_TEST, false}};
+
+struct BenchContext {
+  const ParamSet *paramSet;
+  BINFHEMETHOD method;
+  CryptoContextImpl<DCRTPoly> cc;
+  LWEPrivateKey sk;
+  RingGSWEvalKey EK;
+};
+
+// The benchmarks of a parameter set and method are registered next to each
+// other, so only the last context is kept: the AP keys of the larger sets
+// take gigabytes.
+BenchContext &GetContext(const ParamSet *paramSet, BINFHEMETHOD method) {
+  static std::unique_ptr<BenchContext> context;
+  if (context == nullptr || context->paramSet != paramSet ||
+      context->method != method) {
+    context.reset();
+    context.reset(new BenchContext());
+    context->paramSet = paramSet;
+    context->method = method;
+    if (paramSet->dinn)
+      context->cc.Generate_Default_params();
+    else
+      context->cc.HESea_GenerateBinFHEContext(paramSet->set, method);
+    context->sk = context->cc.HESea_KeyGen02();
+    context->cc.HESea_BTKeyGen(context->sk);
+    context->EK.BSkey = context->cc.HESea_GetRefreshKey();
+    context->EK.KSkey = context->cc.HESea_GetSwitchKey();
+  }
+  return *context;
+}
+
+LWEPlaintextModulus SignModulus(const ParamSet *paramSet) {
+  return paramSet->dinn ? DINN_P : BINFHE_P;
+}
+
+// RingLWE accumulator with uniformly random entries, as after a few
+// accumulation steps
+std::shared_ptr<RingGSWCiphertext> RandomAccumulator(
+    const std::shared_ptr<RingGSWCryptoParams> params) {
+  const auto &polyParams = params->GetPolyParams();
+  DiscreteUniformGeneratorImpl<NativeVector> dug;
+  dug.SetModulus(params->GetLWEParams()->GetQ());
+  auto acc = std::make_shared<RingGSWCiphertext>(1, 2);
+  for (uint32_t i = 0; i < 2; i++)
+    (*acc)[0][i] = NativePoly(dug, polyParams, Format::EVALUATION);
+  return acc;
+}
+
+std::shared_ptr<LWECiphertextImpl> RandomLWE(uint32_t n,
+                                             const NativeInteger &q) {
+  DiscreteUniformGeneratorImpl<NativeVector> dug;
+  dug.SetModulus(q);
+  return std::make_shared<LWECiphertextImpl>(dug.GenerateVector(n),
+                                             dug.GenerateInteger());
+}
+
+void BM_EvalSign(benchmark::State &state, const ParamSet *paramSet,
+                 BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  LWEPlaintextModulus p = SignModulus(paramSet);
+  auto ct = ctx.cc.HESea_Encrypt(ctx.sk, 1, p);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ctx.cc.HESea_MyEvalSigndFunc(ct, p));
+}
+
+// latency of one sign evaluation split across state.range(0) threads
+void BM_EvalSignThreads(benchmark::State &state, const ParamSet *paramSet,
+                        BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  LWEPlaintextModulus p = SignModulus(paramSet);
+  auto ct = ctx.cc.HESea_Encrypt(ctx.sk, 1, p);
+  ctx.cc.HESea_SetBootstrapThreads(state.range(0));
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ctx.cc.HESea_MyEvalSigndFunc(ct, p));
+  ctx.cc.HESea_SetBootstrapThreads(1);
+}
+
+void BM_Bootstrap(benchmark::State &state, const ParamSet *paramSet,
+                  BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  auto params = ctx.cc.HESea_GetParams();
+  auto LWEscheme = ctx.cc.HESea_GetLWEScheme();
+  auto ct = LWEscheme->Encrypt(params->GetLWEParams(), ctx.sk, 1);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ctx.cc.HESea_GetRingGSWScheme()->Bootstrap(
+        params, ctx.EK, ct, LWEscheme));
+}
+
+void BM_EvalBinGate(benchmark::State &state, const ParamSet *paramSet,
+                    BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  auto params = ctx.cc.HESea_GetParams();
+  auto LWEscheme = ctx.cc.HESea_GetLWEScheme();
+  auto ct1 = LWEscheme->Encrypt(params->GetLWEParams(), ctx.sk, 1);
+  auto ct2 = LWEscheme->Encrypt(params->GetLWEParams(), ctx.sk, 0);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ctx.cc.HESea_GetRingGSWScheme()->EvalBinGate(
+        params, AND, ctx.EK, ct1, ct2, LWEscheme));
+}
+
+void BM_AddToACCGINX(benchmark::State &state, const ParamSet *paramSet,
+                     BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  auto params = ctx.cc.HESea_GetParams();
+  auto acc = RandomAccumulator(params);
+  NativeInteger a(1);
+  for (auto _ : state)
+    ctx.cc.HESea_GetRingGSWScheme()->AddToACCGINX(
+        params, (*ctx.EK.BSkey)[0][0][0], (*ctx.EK.BSkey)[0][1][0], a, acc);
+}
+
+// the same with the monomials applied as rotations in coefficient form
+void BM_AddToACCGINXRotation(benchmark::State &state, const ParamSet *paramSet,
+                             BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  auto params = ctx.cc.HESea_GetParams();
+  auto scheme = ctx.cc.HESea_GetRingGSWScheme();
+  auto acc = RandomAccumulator(params);
+  NativeInteger a(1);
+  scheme->SetGINXRotation(true);
+  for (auto _ : state)
+    scheme->AddToACCGINX(params, (*ctx.EK.BSkey)[0][0][0],
+                         (*ctx.EK.BSkey)[0][1][0], a, acc);
+  scheme->SetGINXRotation(false);
+}
+
+void BM_EvalSignGINXRotation(benchmark::State &state, const ParamSet *paramSet,
+                             BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  LWEPlaintextModulus p = SignModulus(paramSet);
+  auto ct = ctx.cc.HESea_Encrypt(ctx.sk, 1, p);
+  ctx.cc.HESea_GetRingGSWScheme()->SetGINXRotation(true);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ctx.cc.HESea_MyEvalSigndFunc(ct, p));
+  ctx.cc.HESea_GetRingGSWScheme()->SetGINXRotation(false);
+}
+
+void BM_AddToACCAP(benchmark::State &state, const ParamSet *paramSet,
+                   BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  auto params = ctx.cc.HESea_GetParams();
+  auto acc = RandomAccumulator(params);
+  for (auto _ : state)
+    ctx.cc.HESea_GetRingGSWScheme()->AddToACCAP(
+        params, (*ctx.EK.BSkey)[0][1][0], acc);
+}
+
+void BM_SignedDigitDecompose(benchmark::State &state,
+                             const ParamSet *paramSet, BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  auto params = ctx.cc.HESea_GetParams();
+  auto acc = RandomAccumulator(params);
+  std::vector<NativePoly> ct = acc->GetElements()[0];
+  for (auto &c : ct) c.SetFormat(Format::COEFFICIENT);
+  std::vector<NativePoly> dct(2 * params->GetDigitsG(),
+                              NativePoly(params->GetPolyParams(),
+                                         Format::COEFFICIENT, true));
+  for (auto _ : state)
+    ctx.cc.HESea_GetRingGSWScheme()->SignedDigitDecompose(params, ct, &dct);
+}
+
+void BM_KeySwitch(benchmark::State &state, const ParamSet *paramSet,
+                  BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  const auto &LWEParams = ctx.cc.HESea_GetParams()->GetLWEParams();
+  auto ct = RandomLWE(LWEParams->GetN(), LWEParams->GetqKS());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ctx.cc.HESea_GetLWEScheme()->KeySwitch(
+        LWEParams, ctx.EK.KSkey, ct));
+}
+
+// the same with the key in native words, for keys that are compact by
+// default
+void BM_KeySwitchNative(benchmark::State &state, const ParamSet *paramSet,
+                        BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  const auto &LWEParams = ctx.cc.HESea_GetParams()->GetLWEParams();
+  auto key = std::make_shared<LWESwitchingKey>(*ctx.EK.KSkey);
+  key->SetCompact(false);
+  auto ct = RandomLWE(LWEParams->GetN(), LWEParams->GetqKS());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        ctx.cc.HESea_GetLWEScheme()->KeySwitch(LWEParams, key, ct));
+}
+
+// the two modulus switches of the bootstrapping: Q to qKS before the key
+// switching (dimension N) and qKS to q after it (dimension n)
+void BM_ModSwitchQ(benchmark::State &state, const ParamSet *paramSet,
+                   BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  const auto &LWEParams = ctx.cc.HESea_GetParams()->GetLWEParams();
+  auto ct = RandomLWE(LWEParams->GetN(), LWEParams->GetQ());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        ctx.cc.HESea_GetLWEScheme()->ModSwitch(LWEParams->GetqKS(), ct));
+}
+
+void BM_ModSwitchqKS(benchmark::State &state, const ParamSet *paramSet,
+                     BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  const auto &LWEParams = ctx.cc.HESea_GetParams()->GetLWEParams();
+  auto ct = RandomLWE(LWEParams->Getn(), LWEParams->GetqKS());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        ctx.cc.HESea_GetLWEScheme()->ModSwitch(LWEParams->Getq(), ct));
+}
+
+// the whole switch from (Q,N) to (q,n) after the blind rotation, fused
+void BM_ModKeySwitch(benchmark::State &state, const ParamSet *paramSet,
+                     BINFHEMETHOD method) {
+  auto &ctx = GetContext(paramSet, method);
+  const auto &LWEParams = ctx.cc.HESea_GetParams()->GetLWEParams();
+  auto ct = RandomLWE(LWEParams->GetN(), LWEParams->GetQ());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(ctx.cc.HESea_GetLWEScheme()->ModKeySwitch(
+        LWEParams, ctx.EK.KSkey, ct->GetA(), ct->GetB()));
+}
+
+typedef void (*BenchFunction)(benchmark::State &, const ParamSet *,
+                              BINFHEMETHOD);
+
+benchmark::internal::Benchmark *Register(const char *name, BenchFunction fn,
+                                         const ParamSet *paramSet,
+                                         BINFHEMETHOD method,
+                                         benchmark::TimeUnit unit) {
+  std::string fullName = std::string(name) + "/" + paramSet->name + "/" +
+                         ((method == AP) ? "AP" : "GINX");
+  return benchmark::RegisterBenchmark(fullName.c_str(), fn, paramSet, method)
+      ->Unit(unit);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  for (const auto &paramSet : PARAM_SETS) {
+    for (BINFHEMETHOD method : {GINX, AP}) {
+      // the DiNN parameters are only defined for GINX
+      if (paramSet.dinn && method == AP) continue;
+      Register("EvalSign", BM_EvalSign, &paramSet, method,
+               benchmark::kMillisecond);
+      Register("EvalSignThreads", BM_EvalSignThreads, &paramSet, method,
+               benchmark::kMillisecond)
+          ->Arg(2)
+          ->Arg(4)
+          ->UseRealTime();
+      // gate bootstrapping needs q <= 2N, which the DiNN modulus q = 2^30
+      // is not
+      if (!paramSet.dinn) {
+        Register("Bootstrap", BM_Bootstrap, &paramSet, method,
+                 benchmark::kMillisecond);
+        Register("EvalBinGate", BM_EvalBinGate, &paramSet, method,
+                 benchmark::kMillisecond);
+      }
+      if (method == GINX) {
+        Register("EvalSignGINXRotation", BM_EvalSignGINXRotation, &paramSet,
+                 method, benchmark::kMillisecond);
+        Register("AddToACCGINX", BM_AddToACCGINX, &paramSet, method,
+                 benchmark::kMicrosecond);
+        Register("AddToACCGINXRotation", BM_AddToACCGINXRotation, &paramSet,
+                 method, benchmark::kMicrosecond);
+      } else {
+        Register("AddToACCAP", BM_AddToACCAP, &paramSet, method,
+                 benchmark::kMicrosecond);
+      }
+      Register("SignedDigitDecompose", BM_SignedDigitDecompose, &paramSet,
+               method, benchmark::kMicrosecond);
+      Register("KeySwitch", BM_KeySwitch, &paramSet, method,
+               benchmark::kMicrosecond);
+      Register("KeySwitchNative", BM_KeySwitchNative, &paramSet, method,
+               benchmark::kMicrosecond);
+      Register("ModSwitchQ", BM_ModSwitchQ, &paramSet, method,
+               benchmark::kMicrosecond);
+      Register("ModSwitchqKS", BM_ModSwitchqKS, &paramSet, method,
+               benchmark::kMicrosecond);
+      Register("ModKeySwitch", BM_ModKeySwitch, &paramSet, method,
+               benchmark::kMicrosecond);
+    }
+  }
+
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
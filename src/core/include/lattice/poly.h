@@ -691,6 +691,14 @@ class PolyImpl : public ILElement<PolyImpl<VecType>, VecType> {
    */
   void SwitchFormat();
 
+  /**
+   * @brief Sets the format without transforming the values, e.g., after the
+   * values were overwritten in place in the given format.
+   *
+   * @param format the format of the current values.
+   */
+  void OverrideFormat(const Format format) { m_format = format; }
+
   /**
    * @brief Make the element values sparse. Sets every index not equal to zero
    * mod the wFactor to zero.
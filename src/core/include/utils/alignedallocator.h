@@ -0,0 +1,81 @@
+// @file alignedallocator.h Allocator of over-aligned buffers for vectorized
+// kernels
+// @author TPOC: contact@palisade-crypto.org
+//
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SRC_CORE_LIB_UTILS_ALIGNEDALLOCATOR_H_
+#define SRC_CORE_LIB_UTILS_ALIGNEDALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace lbcrypto {
+
+/**
+ * @brief Allocator whose buffers start at a multiple of ALIGN bytes, e.g.,
+ * a cache line, so that vector loads of a buffer do not cross cache lines.
+ */
+template <typename T, size_t ALIGN = 64>
+class AlignedAllocator {
+ public:
+  typedef T value_type;
+
+  template <typename U>
+  struct rebind {
+    typedef AlignedAllocator<U, ALIGN> other;
+  };
+
+  AlignedAllocator() {}
+
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, ALIGN> &) {}  // NOLINT
+
+  T *allocate(size_t count) {
+    void *ptr = nullptr;
+    if (count == 0) return nullptr;
+    if (posix_memalign(&ptr, ALIGN, count * sizeof(T)) != 0)
+      throw std::bad_alloc();
+    return static_cast<T *>(ptr);
+  }
+
+  void deallocate(T *ptr, size_t) { free(ptr); }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, ALIGN> &) const {
+    return true;
+  }
+
+  template <typename U>
+  bool operator!=(const AlignedAllocator<U, ALIGN> &) const {
+    return false;
+  }
+};
+
+template <typename T, size_t ALIGN = 64>
+using AlignedVector = std::vector<T, AlignedAllocator<T, ALIGN>>;
+
+}  // namespace lbcrypto
+
+#endif
@@ -0,0 +1,105 @@
+// @file spinteam.h Persistent team of spin-waiting threads for fine-grained
+// parallel work
+// @author TPOC: contact@palisade-crypto.org
+//
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SRC_CORE_LIB_UTILS_SPINTEAM_H_
+#define SRC_CORE_LIB_UTILS_SPINTEAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace lbcrypto {
+
+/**
+ * @brief A fixed team of threads that run the same task on request.
+ *
+ * The workers stay alive between tasks and wait by spinning, so handing out
+ * a task costs well below a microsecond, compared to several microseconds
+ * for an OpenMP fork/join. This makes it usable for work items of a few
+ * microseconds, such as the NTTs and products of one bootstrapping step.
+ * A worker that has been idle for a while starts sleeping between checks,
+ * so an unused team does not keep its cores busy.
+ *
+ * Only one thread may call Run at a time.
+ */
+class SpinTeam {
+ public:
+  /**
+   * Starts numThreads - 1 workers; the thread calling Run is the last member
+   * of the team
+   *
+   * @param numThreads number of threads running each task, at least 1
+   */
+  explicit SpinTeam(uint32_t numThreads);
+
+  ~SpinTeam();
+
+  SpinTeam(const SpinTeam &) = delete;
+  SpinTeam &operator=(const SpinTeam &) = delete;
+
+  uint32_t GetNumThreads() const { return m_numThreads; }
+
+  /**
+   * Runs task(t) for every t in [0, GetNumThreads()) and returns when all
+   * calls have finished; the calling thread runs task(0). The first
+   * exception thrown by a call is rethrown.
+   *
+   * @param task callable taking the index of the thread
+   */
+  template <typename F>
+  void Run(F &task) {
+    m_task = &task;
+    m_invoke = [](void *f, uint32_t t) { (*static_cast<F *>(f))(t); };
+    RunTask();
+  }
+
+ private:
+  void RunTask();
+
+  void WorkerLoop(uint32_t t);
+
+  // runs the task of thread t, keeping the first exception
+  void Invoke(uint32_t t);
+
+  uint32_t m_numThreads;
+  std::vector<std::thread> m_workers;
+
+  void *m_task;
+  void (*m_invoke)(void *, uint32_t);
+  std::exception_ptr m_exception;
+  std::atomic<bool> m_failed;
+
+  // incremented to start a task; the workers wait for it to change
+  alignas(64) std::atomic<uint64_t> m_generation;
+  // number of workers that have finished the current task
+  alignas(64) std::atomic<uint32_t> m_done;
+  std::atomic<bool> m_stop;
+};
+
+}  // namespace lbcrypto
+
+#endif
@@ -0,0 +1,200 @@
+// @file stageprofiler.h Latency histograms of named processing stages
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+
+#ifndef SRC_CORE_LIB_UTILS_STAGEPROFILER_H_
+#define SRC_CORE_LIB_UTILS_STAGEPROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lbcrypto {
+
+/**
+ * @brief Log-linear histogram of latencies in nanoseconds.
+ *
+ * Each power of two is split into 16 buckets, so a percentile is reported
+ * with a relative error below 1/16 while the memory does not depend on the
+ * number of samples.
+ */
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void Add(uint64_t ns, uint64_t count = 1);
+
+  void Merge(const LatencyHistogram &other);
+
+  uint64_t GetCount() const { return m_count; }
+
+  uint64_t GetMin() const { return m_count ? m_min : 0; }
+
+  uint64_t GetMax() const { return m_max; }
+
+  double GetMean() const { return m_count ? double(m_sum) / m_count : 0; }
+
+  /**
+   * @param q quantile in [0,1]
+   * @return the middle of the bucket holding the q-quantile, clamped to the
+   * observed minimum and maximum; the first and last samples are exact
+   */
+  uint64_t GetPercentile(double q) const;
+
+ private:
+  static const uint32_t SUB_BITS = 4;
+
+  static uint32_t BucketIndex(uint64_t ns);
+
+  std::vector<uint64_t> m_buckets;
+  uint64_t m_count;
+  uint64_t m_sum;
+  uint64_t m_min;
+  uint64_t m_max;
+};
+
+/**
+ * @brief Wall-clock and thread CPU time latencies of one stage.
+ */
+struct StageStats {
+  LatencyHistogram wall;
+  LatencyHistogram cpu;
+};
+
+/**
+ * @brief Process-wide collection of stage latencies.
+ *
+ * Every thread records into its own set of histograms, so recording does not
+ * contend with the other threads. Profiling is off by default; a disabled
+ * StageTimer only costs the check of one flag.
+ */
+class StageProfiler {
+ public:
+  static void Enable(bool enable = true) {
+    s_enabled.store(enable, std::memory_order_relaxed);
+  }
+
+  static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+  /**
+   * Records count samples of a stage
+   *
+   * @param stage name of the stage
+   * @param wallNs wall-clock time of one sample
+   * @param cpuNs CPU time of the calling thread for one sample
+   * @param count number of samples
+   */
+  static void Record(const std::string &stage, uint64_t wallNs, uint64_t cpuNs,
+                     uint64_t count = 1);
+
+  /**
+   * Clears the samples of all threads
+   */
+  static void Reset();
+
+  /**
+   * @return the samples of all threads, by stage name
+   */
+  static std::map<std::string, StageStats> Collect();
+
+  /**
+   * Prints count, mean, p50, p95, p99 and max of every stage in
+   * microseconds
+   */
+  static void Print(std::ostream &os);
+
+  /**
+   * Writes the statistics of every stage as a JSON object, in microseconds
+   */
+  static void PrintJSON(std::ostream &os);
+
+  /**
+   * @return the CPU time consumed by the calling thread
+   */
+  static uint64_t GetThreadCPUTimeNs();
+
+ private:
+  static std::atomic<bool> s_enabled;
+};
+
+/**
+ * @brief Times a stage from construction to Stop or destruction.
+ *
+ * Next ends the current stage and starts the following one, which times a
+ * sequence of stages without nesting scopes:
+ *
+ *   StageTimer timer("keyswitch");
+ *   ...
+ *   timer.Next("modswitch");
+ *   ...
+ */
+class StageTimer {
+ public:
+  /**
+   * @param stage name of the stage; must outlive the timer
+   * @param count number of items processed by the stage; the time is
+   * recorded as count samples of the time per item
+   */
+  explicit StageTimer(const char *stage, uint64_t count = 1)
+      : m_stage(nullptr) {
+    if (StageProfiler::IsEnabled()) Start(stage, count);
+  }
+
+  ~StageTimer() { Stop(); }
+
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+  void Next(const char *stage, uint64_t count = 1) {
+    if (m_stage == nullptr) return;
+    Stop();
+    Start(stage, count);
+  }
+
+  void Stop() {
+    if (m_stage == nullptr) return;
+    uint64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - m_wallStart)
+                        .count();
+    uint64_t cpu = StageProfiler::GetThreadCPUTimeNs() - m_cpuStart;
+    StageProfiler::Record(m_stage, wall / m_count, cpu / m_count, m_count);
+    m_stage = nullptr;
+  }
+
+ private:
+  void Start(const char *stage, uint64_t count) {
+    m_stage = stage;
+    m_count = count ? count : 1;
+    m_cpuStart = StageProfiler::GetThreadCPUTimeNs();
+    m_wallStart = std::chrono::steady_clock::now();
+  }
+
+  const char *m_stage;
+  uint64_t m_count;
+  uint64_t m_cpuStart;
+  std::chrono::steady_clock::time_point m_wallStart;
+};
+
+}  // namespace lbcrypto
+
+#endif
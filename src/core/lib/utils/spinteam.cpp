@@ -0,0 +1,111 @@
+// @file spinteam.cpp Persistent team of spin-waiting threads
+// @author TPOC: contact@palisade-crypto.org
+//
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "utils/spinteam.h"
+
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace lbcrypto {
+
+// Waiting strategy: spin, then yield, then sleep, depending on how long the
+// thread has been waiting already
+static void Relax(uint32_t spins) {
+  if (spins < (1 << 14)) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+  } else if (spins < (1 << 15)) {
+    std::this_thread::yield();
+  } else {
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+}
+
+SpinTeam::SpinTeam(uint32_t numThreads)
+    : m_numThreads(numThreads ? numThreads : 1),
+      m_task(nullptr),
+      m_invoke(nullptr),
+      m_failed(false),
+      m_generation(0),
+      m_done(0),
+      m_stop(false) {
+  for (uint32_t t = 1; t < m_numThreads; t++)
+    m_workers.emplace_back(&SpinTeam::WorkerLoop, this, t);
+}
+
+SpinTeam::~SpinTeam() {
+  m_stop.store(true, std::memory_order_relaxed);
+  m_generation.fetch_add(1, std::memory_order_release);
+  for (auto &w : m_workers) w.join();
+}
+
+void SpinTeam::RunTask() {
+  m_done.store(0, std::memory_order_relaxed);
+  m_generation.fetch_add(1, std::memory_order_release);
+
+  Invoke(0);
+
+  for (uint32_t spins = 0;
+       m_done.load(std::memory_order_acquire) != m_numThreads - 1; spins++)
+    Relax(spins);
+
+  if (m_failed.load(std::memory_order_relaxed)) {
+    std::exception_ptr e = m_exception;
+    m_exception = nullptr;
+    m_failed.store(false, std::memory_order_relaxed);
+    std::rethrow_exception(e);
+  }
+}
+
+void SpinTeam::WorkerLoop(uint32_t t) {
+  uint64_t seen = 0;
+  for (;;) {
+    uint64_t generation;
+    for (uint32_t spins = 0;
+         (generation = m_generation.load(std::memory_order_acquire)) == seen;
+         spins++)
+      Relax(spins);
+    seen = generation;
+    if (m_stop.load(std::memory_order_relaxed)) return;
+
+    Invoke(t);
+    m_done.fetch_add(1, std::memory_order_release);
+  }
+}
+
+void SpinTeam::Invoke(uint32_t t) {
+  try {
+    m_invoke(m_task, t);
+  } catch (...) {
+    bool expected = false;
+    if (m_failed.compare_exchange_strong(expected, true))
+      m_exception = std::current_exception();
+  }
+}
+
+}  // namespace lbcrypto
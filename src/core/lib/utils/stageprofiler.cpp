@@ -0,0 +1,218 @@
+// @file stageprofiler.cpp Latency histograms of named processing stages
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+
+#include "utils/stageprofiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace lbcrypto {
+
+LatencyHistogram::LatencyHistogram()
+    : m_buckets(BucketIndex(UINT64_MAX) + 1, 0),
+      m_count(0),
+      m_sum(0),
+      m_min(UINT64_MAX),
+      m_max(0) {}
+
+// values below 2^SUB_BITS have a bucket each; above, the bucket is given by
+// the position of the leading bit and the SUB_BITS bits that follow it
+uint32_t LatencyHistogram::BucketIndex(uint64_t ns) {
+  if (ns < (1ULL << SUB_BITS)) return ns;
+  uint32_t msb = 63;
+  while (!(ns >> msb)) msb--;
+  uint32_t shift = msb - SUB_BITS;
+  return ((shift + 1) << SUB_BITS) + ((ns >> shift) & ((1 << SUB_BITS) - 1));
+}
+
+void LatencyHistogram::Add(uint64_t ns, uint64_t count) {
+  if (count == 0) return;
+  m_buckets[BucketIndex(ns)] += count;
+  m_count += count;
+  m_sum += ns * count;
+  m_min = std::min(m_min, ns);
+  m_max = std::max(m_max, ns);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  for (size_t i = 0; i < m_buckets.size(); i++)
+    m_buckets[i] += other.m_buckets[i];
+  m_count += other.m_count;
+  m_sum += other.m_sum;
+  m_min = std::min(m_min, other.m_min);
+  m_max = std::max(m_max, other.m_max);
+}
+
+uint64_t LatencyHistogram::GetPercentile(double q) const {
+  if (m_count == 0) return 0;
+  uint64_t rank = std::max<uint64_t>(1, std::ceil(q * m_count));
+  if (rank == 1) return m_min;
+  if (rank >= m_count) return m_max;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < m_buckets.size(); i++) {
+    seen += m_buckets[i];
+    if (seen < rank) continue;
+    if (i < (1U << SUB_BITS)) return i;
+    uint32_t shift = (i >> SUB_BITS) - 1;
+    uint64_t low = ((1ULL << SUB_BITS) + (i & ((1 << SUB_BITS) - 1))) << shift;
+    uint64_t mid = low + ((1ULL << shift) >> 1);
+    return std::min(std::max(mid, m_min), m_max);
+  }
+  return m_max;
+}
+
+std::atomic<bool> StageProfiler::s_enabled(false);
+
+namespace {
+
+struct ThreadStages {
+  std::mutex mutex;
+  std::map<std::string, StageStats> stages;
+};
+
+// the histograms of each thread are kept after the thread ends
+std::mutex &RegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+std::vector<std::shared_ptr<ThreadStages>> &Registry() {
+  static std::vector<std::shared_ptr<ThreadStages>> registry;
+  return registry;
+}
+
+ThreadStages &LocalStages() {
+  thread_local std::shared_ptr<ThreadStages> local;
+  if (local == nullptr) {
+    local = std::make_shared<ThreadStages>();
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    Registry().push_back(local);
+  }
+  return *local;
+}
+
+}  // namespace
+
+void StageProfiler::Record(const std::string &stage, uint64_t wallNs,
+                           uint64_t cpuNs, uint64_t count) {
+  ThreadStages &local = LocalStages();
+  std::lock_guard<std::mutex> lock(local.mutex);
+  StageStats &stats = local.stages[stage];
+  stats.wall.Add(wallNs, count);
+  stats.cpu.Add(cpuNs, count);
+}
+
+void StageProfiler::Reset() {
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  for (auto &thread : Registry()) {
+    std::lock_guard<std::mutex> threadLock(thread->mutex);
+    thread->stages.clear();
+  }
+}
+
+std::map<std::string, StageStats> StageProfiler::Collect() {
+  std::map<std::string, StageStats> result;
+  std::lock_guard<std::mutex> lock(RegistryMutex());
+  for (auto &thread : Registry()) {
+    std::lock_guard<std::mutex> threadLock(thread->mutex);
+    for (auto &stage : thread->stages) {
+      result[stage.first].wall.Merge(stage.second.wall);
+      result[stage.first].cpu.Merge(stage.second.cpu);
+    }
+  }
+  return result;
+}
+
+void StageProfiler::Print(std::ostream &os) {
+  auto stats = Collect();
+  size_t width = 5;
+  for (auto &stage : stats) width = std::max(width, stage.first.size());
+
+  auto us = [](double ns) { return ns / 1000.; };
+  os << std::left << std::setw(width) << "stage" << std::right << "  clock"
+     << std::setw(10) << "count" << std::setw(12) << "mean" << std::setw(12)
+     << "p50" << std::setw(12) << "p95" << std::setw(12) << "p99"
+     << std::setw(12) << "max" << "  (us)" << std::endl;
+  os << std::fixed << std::setprecision(1);
+  for (auto &stage : stats) {
+    const LatencyHistogram *hist[2] = {&stage.second.wall, &stage.second.cpu};
+    const char *clock[2] = {"wall ", "cpu  "};
+    for (uint32_t c = 0; c < 2; c++) {
+      os << std::left << std::setw(width) << (c ? "" : stage.first)
+         << std::right << "  " << clock[c] << std::setw(10)
+         << hist[c]->GetCount() << std::setw(12) << us(hist[c]->GetMean())
+         << std::setw(12) << us(hist[c]->GetPercentile(0.5)) << std::setw(12)
+         << us(hist[c]->GetPercentile(0.95)) << std::setw(12)
+         << us(hist[c]->GetPercentile(0.99)) << std::setw(12)
+         << us(hist[c]->GetMax()) << std::endl;
+    }
+  }
+  os << std::defaultfloat;
+}
+
+void StageProfiler::PrintJSON(std::ostream &os) {
+  auto stats = Collect();
+  auto print = [&os](const LatencyHistogram &hist) {
+    os << "{\"count\": " << hist.GetCount()
+       << ", \"mean_us\": " << hist.GetMean() / 1000.
+       << ", \"min_us\": " << hist.GetMin() / 1000.
+       << ", \"p50_us\": " << hist.GetPercentile(0.5) / 1000.
+       << ", \"p95_us\": " << hist.GetPercentile(0.95) / 1000.
+       << ", \"p99_us\": " << hist.GetPercentile(0.99) / 1000.
+       << ", \"max_us\": " << hist.GetMax() / 1000. << "}";
+  };
+  os << "{";
+  bool first = true;
+  for (auto &stage : stats) {
+    os << (first ? "" : ",") << "\n  \"" << stage.first << "\": {\"wall\": ";
+    print(stage.second.wall);
+    os << ", \"cpu\": ";
+    print(stage.second.cpu);
+    os << "}";
+    first = false;
+  }
+  os << "\n}" << std::endl;
+}
+
+uint64_t StageProfiler::GetThreadCPUTimeNs() {
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+  // FILETIME counts units of 100 ns
+  uint64_t k = (uint64_t(kernel.dwHighDateTime) << 32) | kernel.dwLowDateTime;
+  uint64_t u = (uint64_t(user.dwHighDateTime) << 32) | user.dwLowDateTime;
+  return (k + u) * 100;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+}  // namespace lbcrypto
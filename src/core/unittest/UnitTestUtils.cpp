@@ -30,8 +30,13 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
 #include "include/gtest/gtest.h"
 
+#include "utils/spinteam.h"
+#include "utils/stageprofiler.h"
 #include "utils/utilities.h"
 
 using namespace std;
@@ -50,3 +55,72 @@ TEST(Utilities, IsPowerOfTwo) {
     EXPECT_FALSE(IsPowerOfTwo(not_power_of_two));
   }
 }
+
+TEST(Utilities, LatencyHistogram) {
+  LatencyHistogram hist;
+  EXPECT_EQ(0U, hist.GetPercentile(0.5));
+  for (uint64_t ns = 1; ns <= 1000; ns++) hist.Add(ns * 1000);
+  EXPECT_EQ(1000U, hist.GetCount());
+  EXPECT_EQ(1000U, hist.GetMin());
+  EXPECT_EQ(1000000U, hist.GetMax());
+  EXPECT_DOUBLE_EQ(500500., hist.GetMean());
+  // percentiles are exact up to the bucket width of 1/16
+  EXPECT_NEAR(500000., hist.GetPercentile(0.5), 500000. / 16);
+  EXPECT_NEAR(990000., hist.GetPercentile(0.99), 990000. / 16);
+  EXPECT_EQ(1000000U, hist.GetPercentile(1));
+
+  LatencyHistogram small;
+  small.Add(3, 5);
+  hist.Merge(small);
+  EXPECT_EQ(1005U, hist.GetCount());
+  EXPECT_EQ(3U, hist.GetPercentile(0));
+}
+
+TEST(Utilities, StageProfiler) {
+  StageProfiler::Reset();
+  {
+    StageTimer timer("test.disabled");
+  }
+  StageProfiler::Enable();
+  {
+    StageTimer timer("test.first", 4);
+    timer.Next("test.second");
+  }
+  StageProfiler::Enable(false);
+
+  auto stats = StageProfiler::Collect();
+  EXPECT_EQ(0U, stats.count("test.disabled"));
+  EXPECT_EQ(4U, stats["test.first"].wall.GetCount());
+  EXPECT_EQ(1U, stats["test.second"].cpu.GetCount());
+
+  std::stringstream json;
+  StageProfiler::PrintJSON(json);
+  EXPECT_NE(std::string::npos, json.str().find("\"test.second\": {\"wall\""));
+  StageProfiler::Reset();
+  EXPECT_EQ(0U, StageProfiler::Collect().size());
+}
+
+TEST(Utilities, SpinTeam) {
+  SpinTeam team(3);
+  EXPECT_EQ(3U, team.GetNumThreads());
+
+  // every thread index runs exactly once per task, and the results of all
+  // threads are visible once Run returns
+  std::vector<uint32_t> hits(3);
+  auto count = [&](uint32_t t) { hits[t]++; };
+  for (uint32_t i = 0; i < 1000; i++) team.Run(count);
+  EXPECT_EQ(std::vector<uint32_t>(3, 1000), hits);
+
+  auto fail = [](uint32_t t) {
+    if (t == 2) throw std::runtime_error("task failed");
+  };
+  EXPECT_THROW(team.Run(fail), std::runtime_error);
+  // the team is still usable after a failed task
+  team.Run(count);
+  EXPECT_EQ(1001U, hits[2]);
+
+  SpinTeam single(1);
+  single.Run(count);
+  EXPECT_EQ(1002U, hits[0]);
+  EXPECT_EQ(1001U, hits[1]);
+}
@@ -0,0 +1,108 @@
+// @file boolean-circuit.cpp - Example for the evaluation of a Boolean circuit
+// (an 8-bit adder)
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, Duality Technologies Inc.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <chrono>
+#include <vector>
+
+#include "binfhecontext.h"
+
+using namespace lbcrypto;
+using namespace std;
+
+int main() {
+  // Sample Program: Step 1: Set CryptoContext
+
+  auto cc = BinFHEContext();
+
+  cc.GenerateBinFHEContext(STD128, AP);
+
+  // Sample Program: Step 2: Key Generation
+
+  auto sk = cc.KeyGen();
+
+  std::cout << "Generating the bootstrapping keys..." << std::endl;
+
+  cc.BTKeyGen(sk);
+
+  std::cout << "Completed the key generation." << std::endl;
+
+  // Sample Program: Step 3: Circuit
+
+  // Ripple-carry adder of two 8-bit numbers. The sum bits are
+  // a XOR b XOR carry, and the carry is MAJORITY(a, b, carry). The XORs of
+  // the input bits do not depend on the carries, so they all are evaluated
+  // in parallel at the first level.
+  const uint32_t bits = 8;
+  BinFHECircuit circuit;
+  std::vector<uint32_t> a(bits), b(bits);
+  for (uint32_t i = 0; i < bits; i++) a[i] = circuit.AddInput();
+  for (uint32_t i = 0; i < bits; i++) b[i] = circuit.AddInput();
+
+  uint32_t carry = circuit.AddGate(AND, a[0], b[0]);
+  circuit.AddOutput(circuit.AddGate(XOR, a[0], b[0]));
+  for (uint32_t i = 1; i < bits; i++) {
+    uint32_t x = circuit.AddGate(XOR, a[i], b[i]);
+    circuit.AddOutput(circuit.AddGate(XOR, x, carry));
+    carry = circuit.AddGate(MAJORITY, {a[i], b[i], carry});
+  }
+  circuit.AddOutput(carry);
+
+  std::cout << "The circuit has " << circuit.GetNumBootstraps()
+            << " bootstrapped gates in " << circuit.GetDepth() << " levels."
+            << std::endl;
+
+  // Sample Program: Step 4: Encryption
+
+  uint32_t x = 201;
+  uint32_t y = 87;
+  std::vector<std::shared_ptr<const LWECiphertextImpl>> inputs;
+  for (uint32_t i = 0; i < bits; i++)
+    inputs.push_back(cc.Encrypt(sk, (x >> i) & 1));
+  for (uint32_t i = 0; i < bits; i++)
+    inputs.push_back(cc.Encrypt(sk, (y >> i) & 1));
+
+  // Sample Program: Step 5: Evaluation
+
+  auto start = std::chrono::steady_clock::now();
+  auto outputs = cc.EvalCircuit(circuit, inputs);
+  auto stop = std::chrono::steady_clock::now();
+
+  std::cout << "Evaluation time: "
+            << std::chrono::duration<double, std::milli>(stop - start).count()
+            << " ms" << std::endl;
+
+  // Sample Program: Step 6: Decryption
+
+  uint32_t sum = 0;
+  for (uint32_t i = 0; i < outputs.size(); i++) {
+    LWEPlaintext result;
+    cc.Decrypt(sk, outputs[i], &result);
+    sum |= result << i;
+  }
+
+  std::cout << "Result of encrypted computation of " << x << " + " << y
+            << " = " << sum << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,166 @@
+// @file bincircuit.h - Header file for BinFHECircuit class, which describes
+// Boolean circuits of binary gates and evaluates them level by level
+//
+// @author TPOC: contact@palisade-crypto.org
+// @copyright Copyright (c) 2019, Duality Technologies Inc.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BINFHE_BINCIRCUIT_H
+#define BINFHE_BINCIRCUIT_H
+
+#include <memory>
+#include <vector>
+
+#include "fhew.h"
+#include "lwe.h"
+#include "lwecore.h"
+#include "ringcore.h"
+
+namespace lbcrypto {
+
+/**
+ * @brief A Boolean circuit: a DAG of inputs, constants, NOT gates and
+ * bootstrapped gates. Nodes are numbered in the order they are added and
+ * only refer to earlier nodes, so the numbering is a topological order.
+ *
+ * The level of a bootstrapped gate is one more than the highest level of its
+ * inputs; inputs are at level 0, and constants and NOT gates, which need no
+ * bootstrapping, are at the level of their input. The gates of one level do
+ * not depend on each other, so Evaluate runs them in parallel.
+ */
+class BinFHECircuit {
+ public:
+  BinFHECircuit() {}
+
+  /**
+   * Adds an input of the circuit; the inputs are passed to Evaluate in the
+   * order they are added
+   *
+   * @return the node of the input
+   */
+  uint32_t AddInput();
+
+  /**
+   * Adds a constant, which is a noiseless encryption of the value
+   *
+   * @param value the Boolean value
+   * @return the node of the constant
+   */
+  uint32_t AddConstant(bool value);
+
+  /**
+   * Adds a NOT gate, which is evaluated without bootstrapping
+   *
+   * @param input the node of the input
+   * @return the node of the gate
+   */
+  uint32_t AddNOT(uint32_t input);
+
+  /**
+   * Adds a bootstrapped gate of two inputs
+   *
+   * @param gate the gate; can be AND, OR, NAND, NOR, XOR, or XNOR
+   * @param input1 the node of the first input
+   * @param input2 the node of the second input
+   * @return the node of the gate
+   */
+  uint32_t AddGate(BINGATE gate, uint32_t input1, uint32_t input2);
+
+  /**
+   * Adds a bootstrapped gate of two or three inputs (see
+   * RingGSWAccumulatorScheme::EvalBinGate). The outputs of gates have
+   * plaintext modulus 4, so AND3 and OR3 can only take inputs of the circuit
+   * that are encrypted with plaintext modulus 6
+   *
+   * @param gate the gate
+   * @param &inputs the nodes of the inputs, which must be distinct
+   * @return the node of the gate
+   */
+  uint32_t AddGate(BINGATE gate, const std::vector<uint32_t> &inputs);
+
+  /**
+   * Marks a node as an output; the outputs are returned by Evaluate in the
+   * order they are added
+   *
+   * @param node the node
+   */
+  void AddOutput(uint32_t node);
+
+  uint32_t GetNumInputs() const { return m_inputs.size(); }
+
+  uint32_t GetNumOutputs() const { return m_outputs.size(); }
+
+  /**
+   * @return the number of bootstrapped gates
+   */
+  uint32_t GetNumBootstraps() const;
+
+  /**
+   * @return the number of levels of bootstrapped gates
+   */
+  uint32_t GetDepth() const { return m_gates.size() - 1; }
+
+  /**
+   * Evaluates the circuit. The bootstrapped gates of each level are split
+   * across threads, which share the bootstrapping keys.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK the bootstrapping keys
+   * @param &scheme the RingGSW accumulator scheme
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @param &inputs a ciphertext for each input of the circuit
+   * @return a ciphertext for each output of the circuit
+   */
+  std::vector<std::shared_ptr<LWECiphertextImpl>> Evaluate(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const RingGSWEvalKey &EK, const RingGSWAccumulatorScheme &scheme,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme,
+      const std::vector<std::shared_ptr<const LWECiphertextImpl>> &inputs)
+      const;
+
+ private:
+  enum NodeType { INPUT_NODE, CONSTANT_NODE, NOT_NODE, GATE_NODE };
+
+  typedef struct {
+    NodeType type;
+    // gate of a GATE_NODE
+    BINGATE gate;
+    // value of a CONSTANT_NODE
+    bool value;
+    std::vector<uint32_t> inputs;
+    uint32_t level;
+  } Node;
+
+  // checks that the inputs exist, sets the level and adds the node to its
+  // level
+  uint32_t AddNode(Node node);
+
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_inputs;
+  std::vector<uint32_t> m_outputs;
+  // bootstrapped gates by level; level 0 has none
+  std::vector<std::vector<uint32_t>> m_gates = {{}};
+  // constants and NOT gates by level, in topological order
+  std::vector<std::vector<uint32_t>> m_freeNodes = {{}};
+};
+
+}  // namespace lbcrypto
+
+#endif
@@ -27,8 +27,11 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "bincircuit.h"
 #include "fhew.h"
+#include "keystream.h"
 #include "lwe.h"
 #include "lwecore.h"
 #include "math/backend.h"
@@ -92,8 +95,6 @@ using LWEPrivateKey = std::shared_ptr<LWEPrivateKeyImpl>;
 
 using ConstLWEPrivateKey = const std::shared_ptr<const LWEPrivateKeyImpl>;
 
-using LWEPlaintextModulus = uint64_t;
-
 /**
  * @brief BinFHEContext
  *
@@ -234,6 +235,32 @@ class BinFHEContext : public Serializable {
   LWECiphertext EvalBinGate(const BINGATE gate, ConstLWECiphertext ct1,
                             ConstLWECiphertext ct2) const;
 
+  /**
+   * Evaluates a gate of two or three inputs with a single bootstrapping
+   *
+   * @param gate the gate; MAJORITY, AND3 and OR3 take three inputs, and the
+   * inputs of AND3 and OR3 must be encrypted with plaintext modulus 6
+   * @param &cts the input ciphertexts
+   * @return a shared pointer to the resulting ciphertext
+   */
+  LWECiphertext EvalBinGate(
+      const BINGATE gate,
+      const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts) const;
+
+  /**
+   * Evaluates a threshold gate, which is 1 if at least threshold of the
+   * inputs are 1, with a single bootstrapping
+   *
+   * @param &cts the input ciphertexts, encrypted with plaintext modulus p
+   * @param threshold number of inputs that have to be 1
+   * @param p plaintext modulus of the inputs; twice the number of inputs
+   * works for every threshold
+   * @return a shared pointer to the resulting ciphertext
+   */
+  LWECiphertext EvalThresholdGate(
+      const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts,
+      uint32_t threshold, LWEPlaintextModulus p) const;
+
   /**
    * Bootstraps a ciphertext (without peforming any operation)
    *
@@ -242,6 +269,16 @@ class BinFHEContext : public Serializable {
    */
   LWECiphertext Bootstrap(ConstLWECiphertext ct1) const;
 
+  /**
+   * Sets the number of threads sharing each single bootstrapping, to lower
+   * the latency of one gate at a time; 0 or 1 runs it on the calling thread
+   *
+   * @param numThreads number of threads
+   */
+  void SetBootstrapThreads(uint32_t numThreads) {
+    m_RingGSWscheme->SetBootstrapThreads(numThreads);
+  }
+
   /**
    * Evaluates NOT gate
    *
@@ -250,6 +287,19 @@ class BinFHEContext : public Serializable {
    */
   LWECiphertext EvalNOT(ConstLWECiphertext ct1) const;
 
+  /**
+   * Evaluates a Boolean circuit; the bootstrapped gates of each level of the
+   * circuit are evaluated in parallel
+   *
+   * @param &circuit the circuit
+   * @param &inputs a ciphertext for each input of the circuit
+   * @return a ciphertext for each output of the circuit
+   */
+  std::vector<LWECiphertext> EvalCircuit(
+      const BinFHECircuit &circuit,
+      const std::vector<std::shared_ptr<const LWECiphertextImpl>> &inputs)
+      const;
+
   /**
    * Evaluates constant gate
    *
@@ -315,10 +365,12 @@ class BinFHEContext : public Serializable {
   std::shared_ptr<RingGSWCryptoParams> m_params;
 
   // Shared pointer to the underlying additive LWE scheme
-  std::shared_ptr<LWEEncryptionScheme> m_LWEscheme;
+  std::shared_ptr<LWEEncryptionScheme> m_LWEscheme =
+      std::make_shared<LWEEncryptionScheme>();
 
   // Shared pointer to the underlying RingGSW/RLWE scheme
-  std::shared_ptr<RingGSWAccumulatorScheme> m_RingGSWscheme;
+  std::shared_ptr<RingGSWAccumulatorScheme> m_RingGSWscheme =
+      std::make_shared<RingGSWAccumulatorScheme>();
 
   // Struct containing the bootstrapping keys
   RingGSWEvalKey m_BTKey;
@@ -36,11 +36,58 @@
 #ifndef BINFHE_FHEW_H
 #define BINFHE_FHEW_H
 
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <tuple>
+#include <vector>
+
 #include "lwe.h"
 #include "ringcore.h"
+#include "utils/spinteam.h"
 
 namespace lbcrypto {
 
+// The struct for storing a test vector in both representations
+typedef struct {
+  // coefficients for b = 0, used for the rotation by coefficients
+  NativeVector coefficients;
+  // the same polynomial in evaluation form, used for the rotation by a
+  // monomial
+  NativePoly evaluation;
+} RingGSWTestVector;
+
+/**
+ * @brief Scratch buffers of the accumulator updates, so that the loop of the
+ * blind rotation does not allocate. Each thread keeps its own workspace (see
+ * RingGSWAccumulatorScheme::GetWorkspace) and reuses it across bootstraps.
+ */
+class BlindRotateWorkspace {
+ public:
+  explicit BlindRotateWorkspace(
+      const std::shared_ptr<RingGSWCryptoParams> params);
+
+  /**
+   * Checks whether the buffers have the sizes of the given parameters
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @return true if the workspace can be used for the parameters
+   */
+  bool Matches(const std::shared_ptr<RingGSWCryptoParams> params) const;
+
+  // the accumulator in coefficient form
+  std::vector<NativePoly> ct;
+  // its signed digits, an RLWE' ciphertext
+  std::vector<NativePoly> dct;
+  // the external product of the digits with a refreshing key entry
+  std::vector<NativePoly> prod;
+  // Barrett constant of Q
+  NativeInteger mu;
+};
+
 /**
  * @brief Ring GSW accumulator schemes described in
  * https://eprint.iacr.org/2014/816 and "Bootstrapping in FHEW-like
@@ -64,6 +111,25 @@ class RingGSWAccumulatorScheme {
       const std::shared_ptr<LWEEncryptionScheme> lwescheme,
       const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk) const;
 
+  /**
+   * Generates the bootstrapping keys and writes the refreshing key to a
+   * stream while it is generated (see RingGSWBTKeyWriter), so that only a
+   * block of its entries is held in memory. The refreshing key is read back
+   * with ReadRingGSWBTKey.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @param LWEsk a shared pointer to the secret key of the underlying additive
+   * LWE scheme
+   * @param &os the output stream of the refreshing key
+   * @return the keys with the switching key only
+   */
+  RingGSWEvalKey KeyGen(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const std::shared_ptr<LWEEncryptionScheme> lwescheme,
+      const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk,
+      std::ostream &os) const;
+
   /**
    * Evaluates a binary gate (calls bootstrapping as a subroutine)
    *
@@ -82,6 +148,45 @@ class RingGSWAccumulatorScheme {
       const std::shared_ptr<const LWECiphertextImpl> ct2,
       const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
 
+  /**
+   * Evaluates a gate of two or three inputs with a single bootstrapping
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param gate the gate; MAJORITY, AND3 and OR3 take three inputs, and the
+   * inputs of AND3 and OR3 must be encrypted with plaintext modulus 6
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param &cts the input ciphertexts
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return a shared pointer to the resulting ciphertext
+   */
+  std::shared_ptr<LWECiphertextImpl> EvalBinGate(
+      const std::shared_ptr<RingGSWCryptoParams> params, const BINGATE gate,
+      const RingGSWEvalKey &EK,
+      const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
+  /**
+   * Evaluates a threshold gate, which is 1 if at least threshold of the k
+   * inputs are 1, with a single bootstrapping. The inputs are bits encrypted
+   * with plaintext modulus p; p = 2k works for every threshold, and smaller
+   * moduli only for some (e.g., p = 4 for MAJORITY). The output is a bit
+   * with plaintext modulus 4, as for the other gates.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param &cts the input ciphertexts
+   * @param threshold number of inputs that have to be 1, from 1 to k
+   * @param p plaintext modulus of the inputs
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return a shared pointer to the resulting ciphertext
+   */
+  std::shared_ptr<LWECiphertextImpl> EvalThresholdGate(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const RingGSWEvalKey &EK,
+      const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts,
+      uint32_t threshold, const LWEPlaintextModulus p,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
   /**
    * Evaluates NOT gate
    *
@@ -108,16 +213,134 @@ class RingGSWAccumulatorScheme {
       const std::shared_ptr<const LWECiphertextImpl> ct1,
       const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
 
+  /**
+   * Evaluates the sign function of a ciphertext modulo p (used by the hidden
+   * layers of discretized neural networks)
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param ct input ciphertext
+   * @param p plaintext modulus
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return a shared pointer to the resulting ciphertext
+   */
+  std::shared_ptr<LWECiphertextImpl> EvalSign(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const RingGSWEvalKey &EK,
+      const std::shared_ptr<const LWECiphertextImpl> ct,
+      const LWEPlaintextModulus p,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
+  /**
+   * Evaluates the sign function of a batch of ciphertexts modulo p. The batch
+   * is split across threads sharing the same (read-only) refreshing key, and
+   * every refreshing key entry is applied to all accumulators of a thread
+   * before moving on to the next one.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param &cts input ciphertexts
+   * @param p plaintext modulus
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return the resulting ciphertexts, in the order of the inputs
+   */
+  std::vector<std::shared_ptr<LWECiphertextImpl>> EvalSignBatch(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const RingGSWEvalKey &EK,
+      const std::vector<std::shared_ptr<LWECiphertextImpl>> &cts,
+      const LWEPlaintextModulus p,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
+  /**
+   * Evaluates a lookup table over Z_p in a single bootstrapping
+   * (programmable bootstrapping). The rotation of the test vector is
+   * negacyclic, so the whole of Z_p can only be used for tables with
+   * LUT[m + p/2] = -LUT[m]; for other tables the input must lie in [0, p/2),
+   * e.g., a signed input in [-p/4, p/4) shifted by p/4.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param ct input ciphertext
+   * @param &LUT the table; LUT[m] is the output for the message m
+   * @param p plaintext modulus of the input and the output
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return a shared pointer to the resulting ciphertext
+   */
+  std::shared_ptr<LWECiphertextImpl> EvalFunc(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const RingGSWEvalKey &EK,
+      const std::shared_ptr<const LWECiphertextImpl> ct,
+      const std::vector<LWEPlaintext> &LUT, const LWEPlaintextModulus p,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
+  /**
+   * Evaluates several lookup tables over Z_p on the same input with a single
+   * blind rotation (multi-value bootstrapping). The accumulator is rotated
+   * from a test vector that does not depend on the tables and is multiplied
+   * by a small factor of each table before the extraction, so each output
+   * costs one key switching instead of a bootstrapping. The noise of the
+   * outputs grows with the jumps between consecutive table entries, so the
+   * tables should be small or smooth. The input range is the same as for
+   * EvalFunc.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param ct input ciphertext
+   * @param &LUTs the tables; LUTs[k][m] is the output k for the message m
+   * @param p plaintext modulus of the input and the outputs
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return a ciphertext for each table, in the same order
+   */
+  std::vector<std::shared_ptr<LWECiphertextImpl>> EvalMultiFunc(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const RingGSWEvalKey &EK,
+      const std::shared_ptr<const LWECiphertextImpl> ct,
+      const std::vector<std::vector<LWEPlaintext>> &LUTs,
+      const LWEPlaintextModulus p,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
+  /**
+   * Returns the factor of a lookup table used by EvalMultiFunc, generating
+   * it on first use. Factors are cached like test vectors.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &LUT the table; LUT[m] is the output for the message m
+   * @param p plaintext modulus
+   * @return the factor, whose product with the test vector of
+   * GetMultiFuncTestVector is the test vector of the table
+   */
+  std::shared_ptr<const RingGSWTestVector> GetTestVectorFactor(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const std::vector<LWEPlaintext> &LUT,
+      const LWEPlaintextModulus p) const;
+
+  /**
+   * Returns the test vector of a lookup table, generating it on first use.
+   * Test vectors are cached by table, plaintext modulus and ring (N, Q).
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &LUT the table; LUT[m] is the output for the message m
+   * @param p plaintext modulus
+   * @return the test vector for b = 0
+   */
+  std::shared_ptr<const RingGSWTestVector> GetTestVector(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const std::vector<LWEPlaintext> &LUT,
+      const LWEPlaintextModulus p) const;
+
   /**
    * Main accumulator function used in bootstrapping - AP variant
    *
    * @param params a shared pointer to RingGSW scheme parameters
    * @param &input input ciphertext
    * @param acc previous value of the accumulator
+   * @param team threads sharing the update, or nullptr to run it on the
+   * calling thread
    */
   void AddToACCAP(const std::shared_ptr<RingGSWCryptoParams> params,
                   const RingGSWCiphertext &input,
-                  std::shared_ptr<RingGSWCiphertext> acc) const;
+                  std::shared_ptr<RingGSWCiphertext> acc,
+                  SpinTeam *team = nullptr) const;
                   
    /**
    * Main accumulator function used in bootstrapping - GINX variant
@@ -127,42 +350,154 @@ class RingGSWAccumulatorScheme {
    * @param &input2 input ciphertext 2
    * @param &a integer a in each step of GINX accumulation
    * @param acc previous value of the accumulator
+   * @param team threads sharing the update, or nullptr to run it on the
+   * calling thread
    */
 
   void AddToACCGINX(const std::shared_ptr<RingGSWCryptoParams> params,
                     const RingGSWCiphertext &input1,  
                     const RingGSWCiphertext &input2, 
                     const NativeInteger &a,
-                    std::shared_ptr<RingGSWCiphertext> acc) const;
+                    std::shared_ptr<RingGSWCiphertext> acc,
+                    SpinTeam *team = nullptr) const;
+
+  /**
+   * Takes an RLWE ciphertext input and outputs a vector of its digits, i.e., an
+   * RLWE' ciphertext. The output polynomials must already have N
+   * coefficients; all of them are overwritten.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &input input RLWE ciphertext
+   * @param *output input RLWE ciphertext
+   */
+  void SignedDigitDecompose(const std::shared_ptr<RingGSWCryptoParams> params,
+                            const std::vector<NativePoly> &input,
+                            std::vector<NativePoly> *output) const;
+
+  /**
+   * Returns the workspace of the calling thread, resized for the parameters
+   * if it was last used with other ones
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @return the workspace of the calling thread
+   */
+  static BlindRotateWorkspace &GetWorkspace(
+      const std::shared_ptr<RingGSWCryptoParams> params);
+
+  /**
+   * Sets the number of threads used by a single bootstrapping. With more
+   * than one thread, each accumulator update of EvalSign, EvalFunc and the
+   * binary gates is split across a persistent team of spin-waiting threads,
+   * which lowers the latency of one bootstrapping. Batched evaluation and
+   * calls from parallel regions keep running one bootstrapping per thread.
+   *
+   * @param numThreads number of threads, at most the number of hardware
+   * threads; 0 or 1 disables the team
+   */
+  void SetBootstrapThreads(uint32_t numThreads);
+
+  /**
+   * @return the number of threads used by a single bootstrapping
+   */
+  uint32_t GetBootstrapThreads() const;
+
+  /**
+   * Selects how the GINX accumulator update applies the monomials X^a - 1.
+   * By default the products with the refreshing key are multiplied by the
+   * precomputed monomials in evaluation form. With the rotation enabled, the
+   * products are switched to coefficient form and X^a - 1 is applied as a
+   * negacyclic rotation, and the accumulator stays in coefficient form
+   * between the updates, which saves its inverse NTTs. Updates split across
+   * a bootstrapping team always use the precomputed monomials. Both give
+   * the same ciphertexts.
+   *
+   * @param rotate true to apply the monomials as rotations
+   */
+  void SetGINXRotation(bool rotate) { m_ginxRotation = rotate; }
+
+  /**
+   * @return true if the GINX monomials are applied as rotations
+   */
+  bool GetGINXRotation() const { return m_ginxRotation; }
+
+  /**
+   * Sets the number of threads generating the refreshing and switching keys,
+   * e.g., to stay within the limits of a container
+   *
+   * @param numThreads number of threads; 0 uses all OpenMP threads
+   */
+  void SetKeyGenThreads(uint32_t numThreads) { m_keyGenThreads = numThreads; }
+
+  /**
+   * @return the number of threads generating keys
+   */
+  uint32_t GetKeyGenThreads() const;
+
+  // called with the number of refreshing key entries generated so far and
+  // the number of entries of the key
+  typedef std::function<void(uint32_t done, uint32_t total)> KeyGenProgress;
+
+  /**
+   * Sets a function that reports the progress of the key generation. It is
+   * called on the calling thread of KeyGen after each block of refreshing
+   * key entries (KEYGEN_BLOCK entries per thread), and should be set before
+   * the keys are generated.
+   *
+   * @param &progress the function; empty for no reports
+   */
+  void SetKeyGenProgress(const KeyGenProgress &progress) {
+    m_keyGenProgress = progress;
+  }
+
+  // refreshing key entries generated per thread between progress reports;
+  // with the streaming KeyGen, the entries held in memory
+  static const uint32_t KEYGEN_BLOCK = 16;
 
  private:
   /**
-   * Generates a refreshing key - GINX variant
+   * Generates the switching key and the RingLWE secret key of the
+   * refreshing key
    *
    * @param params a shared pointer to RingGSW scheme parameters
    * @param lwescheme a shared pointer to additive LWE scheme
    * @param LWEsk a shared pointer to the secret key of the underlying additive
    * LWE scheme
-   * @return a shared pointer to the refreshing key
+   * @param *ek the keys; the switching key is set
+   * @return the RingLWE secret key in evaluation form
    */
-  RingGSWEvalKey KeyGenGINX(
+  NativePoly KeyGenSwitching(
       const std::shared_ptr<RingGSWCryptoParams> params,
       const std::shared_ptr<LWEEncryptionScheme> lwescheme,
-      const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk) const;
+      const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk,
+      RingGSWEvalKey *ek) const;
 
   /**
-   * Generates a refreshing key - AP variant
+   * Returns the dimensions of the refreshing key: (n, baseR, digitsR) for AP
+   * and (1, 2, n) for GINX
    *
    * @param params a shared pointer to RingGSW scheme parameters
-   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return the three dimensions
+   */
+  static std::vector<uint32_t> KeyDims(
+      const std::shared_ptr<RingGSWCryptoParams> params);
+
+  /**
+   * Encrypts consecutive entries of the refreshing key in parallel. Entries
+   * are numbered in the order of the key's indices, the last one varying
+   * fastest; the AP entries for the digit 0 are left empty.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param skNTT RingLWE secret key in evaluation form
    * @param LWEsk a shared pointer to the secret key of the underlying additive
    * LWE scheme
-   * @return a shared pointer to the refreshing key
+   * @param begin number of the first entry
+   * @param &entries the entries begin, begin + 1, ..., overwritten in place
    */
-  RingGSWEvalKey KeyGenAP(
+  void EncryptKeyEntries(
       const std::shared_ptr<RingGSWCryptoParams> params,
-      const std::shared_ptr<LWEEncryptionScheme> lwescheme,
-      const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk) const;
+      const NativePoly &skNTT,
+      const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk, uint32_t begin,
+      const std::vector<RingGSWCiphertext *> &entries) const;
 
   /**
    * Internal RingGSW encryption used in generating the refreshing key - AP
@@ -172,11 +507,11 @@ class RingGSWAccumulatorScheme {
    * @param skFFT secret key polynomial in the EVALUATION representation
    * @param m plaintext (corresponds to a lookup entry for the LWE scheme secret
    * key)
-   * @return a shared pointer to the resulting ciphertext
+   * @param *result the resulting ciphertext, overwritten in place
    */
-  std::shared_ptr<RingGSWCiphertext> EncryptAP(
-      const std::shared_ptr<RingGSWCryptoParams> params,
-      const NativePoly &skFFT, const LWEPlaintext &m) const;
+  void EncryptAP(const std::shared_ptr<RingGSWCryptoParams> params,
+                 const NativePoly &skFFT, const LWEPlaintext &m,
+                 RingGSWCiphertext *result) const;
 
   /**
    * Internal RingGSW encryption used in generating the refreshing key - GINX
@@ -186,42 +521,211 @@ class RingGSWAccumulatorScheme {
    * @param skFFT secret key polynomial in the EVALUATION representation
    * @param m plaintext (corresponds to a lookup entry for the LWE scheme secret
    * key)
-   * @return a shared pointer to the resulting ciphertext
+   * @param *result the resulting ciphertext, overwritten in place
    */
-  std::shared_ptr<RingGSWCiphertext> EncryptGINX(
+  void EncryptGINX(const std::shared_ptr<RingGSWCryptoParams> params,
+                   const NativePoly &skFFT, const LWEPlaintext &m,
+                   RingGSWCiphertext *result) const;
+
+
+
+  /**
+   * Builds the initial accumulator holding the test vector of the sign
+   * function
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &b second part of the input LWE ciphertext (modulo 2N)
+   * @param p plaintext modulus
+   * @return the initial RingLWE accumulator
+   */
+  std::shared_ptr<RingGSWCiphertext> SignAccumulator(
+      const std::shared_ptr<RingGSWCryptoParams> params, const NativeInteger &b,
+      const LWEPlaintextModulus p) const;
+
+  /**
+   * Returns the test vector of the sign function, generating it on first
+   * use. Test vectors are cached by plaintext modulus and ring (N, Q).
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param p plaintext modulus
+   * @return the test vector for b = 0
+   */
+  std::shared_ptr<const RingGSWTestVector> GetSignTestVector(
       const std::shared_ptr<RingGSWCryptoParams> params,
-      const NativePoly &skFFT, const LWEPlaintext &m) const;
+      const LWEPlaintextModulus p) const;
 
+  /**
+   * Returns the test vector shared by all tables of EvalMultiFunc,
+   * generating it on first use. Test vectors are cached by plaintext modulus
+   * and ring (N, Q).
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param p plaintext modulus
+   * @return the test vector for b = 0
+   */
+  std::shared_ptr<const RingGSWTestVector> GetMultiFuncTestVector(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const LWEPlaintextModulus p) const;
 
+  /**
+   * Builds the initial accumulator for a test vector: the test vector
+   * rotated negacyclically by b. For GINX the rotation is a product with the
+   * precomputed monomial X^b - 1 in evaluation form, so no NTT is needed.
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &testVector the test vector for b = 0
+   * @param &b second part of the input LWE ciphertext (modulo 2N)
+   * @return the initial RingLWE accumulator
+   */
+  std::shared_ptr<RingGSWCiphertext> RotatedAccumulator(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const RingGSWTestVector &testVector, const NativeInteger &b) const;
 
   /**
-   * Takes an RLWE ciphertext input and outputs a vector of its digits, i.e., an
-   * RLWE' ciphertext
+   * Applies the refreshing key entries of index i to the accumulator
    *
    * @param params a shared pointer to RingGSW scheme parameters
-   * @param &input input RLWE ciphertext
-   * @param *output input RLWE ciphertext
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param i index of the LWE secret key component
+   * @param &aNeg i-th component of the negated input "a" modulo mod
+   * @param &mod modulus of the input LWE ciphertext
+   * @param acc previous value of the accumulator
+   * @param team threads sharing the update, or nullptr
+   */
+  void BlindRotateStep(const std::shared_ptr<RingGSWCryptoParams> params,
+                       const RingGSWEvalKey &EK, uint32_t i,
+                       const NativeInteger &aNeg, const NativeInteger &mod,
+                       std::shared_ptr<RingGSWCiphertext> acc,
+                       SpinTeam *team) const;
+
+  /**
+   * Applies all refreshing key entries to the accumulator, using the
+   * bootstrapping team if one is set and not in use
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param &a first part of the input LWE ciphertext (modulo mod)
+   * @param &mod modulus of the input LWE ciphertext
+   * @param acc the initial accumulator; GINX with rotations leaves it in
+   * coefficient form
    */
-  inline void SignedDigitDecompose(
+  void BlindRotate(const std::shared_ptr<RingGSWCryptoParams> params,
+                   const RingGSWEvalKey &EK, const NativeVector &a,
+                   const NativeInteger &mod,
+                   std::shared_ptr<RingGSWCiphertext> acc) const;
+
+  /**
+   * Extracts the LWE ciphertext of the sign function from the accumulator and
+   * switches it back to (q,n)
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param acc the RingLWE accumulator after blind rotation
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return a shared pointer to the resulting ciphertext
+   */
+  std::shared_ptr<LWECiphertextImpl> SignExtract(
       const std::shared_ptr<RingGSWCryptoParams> params,
-      const std::vector<NativePoly> &input,
-      std::vector<NativePoly> *output) const;
+      const RingGSWEvalKey &EK, std::shared_ptr<RingGSWCiphertext> acc,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
 
   /**
    * Core bootstrapping operation
    *
    * @param params a shared pointer to RingGSW scheme parameters
+   * @param &gateConst start of the range of phases mapped to 0 (see
+   * RingGSWCryptoParams::GetGateConst)
    * @param &EK a shared pointer to the bootstrapping keys
-   * @param gate the gate; can be AND, OR, NAND, NOR, XOR, or XOR
    * @param &a first part of the input LWE ciphertext
    * @param &b second part of the input LWE ciphertext
    * @param lwescheme a shared pointer to additive LWE scheme
    * @return the output RingLWE accumulator
    */
   std::shared_ptr<RingGSWCiphertext> BootstrapCore(
-      const std::shared_ptr<RingGSWCryptoParams> params, const BINGATE gate,
-      const RingGSWEvalKey &EK, const NativeVector &a, const NativeInteger &b,
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const NativeInteger &gateConst, const RingGSWEvalKey &EK,
+      const NativeVector &a, const NativeInteger &b,
       const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
+  /**
+   * Extracts the LWE ciphertext of the constant coefficient of the
+   * accumulator and switches it back to (q,n); the accumulator is changed
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param acc the RingLWE accumulator after blind rotation
+   * @param &bOffset value added to the second part before the switch
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return a shared pointer to the resulting ciphertext
+   */
+  std::shared_ptr<LWECiphertextImpl> ExtractAndSwitch(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const RingGSWEvalKey &EK, std::shared_ptr<RingGSWCiphertext> acc,
+      const NativeInteger &bOffset,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
+  /**
+   * Bootstraps the combined input of a gate and switches the result back to
+   * (q,n)
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &gateConst start of the range of phases mapped to 0
+   * @param &EK a shared pointer to the bootstrapping keys
+   * @param &a first part of the combined LWE ciphertext
+   * @param &b second part of the combined LWE ciphertext
+   * @param lwescheme a shared pointer to additive LWE scheme
+   * @return a shared pointer to the resulting ciphertext
+   */
+  std::shared_ptr<LWECiphertextImpl> GateBootstrap(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const NativeInteger &gateConst, const RingGSWEvalKey &EK,
+      const NativeVector &a, const NativeInteger &b,
+      const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const;
+
+  /**
+   * Adds the inputs of a multi-input gate, which must be distinct
+   *
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param &cts the input ciphertexts, at least one
+   * @param *a first part of the sum
+   * @param *b second part of the sum
+   */
+  void SumInputs(
+      const std::shared_ptr<RingGSWCryptoParams> params,
+      const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts,
+      NativeVector *a, NativeInteger *b) const;
+
+  // test vectors by (p, N, Q, table)
+  typedef std::tuple<LWEPlaintextModulus, uint32_t, uint64_t,
+                     std::vector<LWEPlaintext>>
+      TestVectorKey;
+  mutable std::map<TestVectorKey, std::shared_ptr<const RingGSWTestVector>>
+      m_testVectors;
+  // sign test vectors by (p, N, Q)
+  typedef std::tuple<LWEPlaintextModulus, uint32_t, uint64_t>
+      SignTestVectorKey;
+  mutable std::map<SignTestVectorKey,
+                   std::shared_ptr<const RingGSWTestVector>>
+      m_signTestVectors;
+  // factors of EvalMultiFunc by (p, N, Q, table)
+  mutable std::map<TestVectorKey, std::shared_ptr<const RingGSWTestVector>>
+      m_testVectorFactors;
+  // test vectors of EvalMultiFunc by (p, N, Q)
+  mutable std::map<SignTestVectorKey,
+                   std::shared_ptr<const RingGSWTestVector>>
+      m_multiFuncTestVectors;
+  mutable std::mutex m_testVectorsMutex;
+
+  // threads of a single bootstrapping, null if it runs on one thread
+  std::shared_ptr<SpinTeam> m_team;
+  mutable std::mutex m_teamMutex;
+
+  // GINX monomials applied as rotations of the products in coefficient form
+  std::atomic<bool> m_ginxRotation{false};
+
+  // threads of the key generation, 0 for all
+  uint32_t m_keyGenThreads = 0;
+  KeyGenProgress m_keyGenProgress;
 };
 
 }  // namespace lbcrypto
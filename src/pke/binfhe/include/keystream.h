@@ -0,0 +1,100 @@
+// @file keystream.h - Header file for the binary streams of refreshing keys,
+// which are written entry by entry as the keys are generated
+//
+// @author TPOC: contact@palisade-crypto.org
+// @copyright Copyright (c) 2019, Duality Technologies Inc.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BINFHE_KEYSTREAM_H
+#define BINFHE_KEYSTREAM_H
+
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "ringcore.h"
+
+namespace lbcrypto {
+
+/**
+ * @brief Writes a refreshing key to a binary stream one entry at a time, in
+ * the order of the key's indices (the last index varies fastest), so that a
+ * key can be written while it is generated without holding it in memory.
+ *
+ * The stream starts with a header holding the dimensions of the key and the
+ * ring (N, Q). Each entry is its number of rows followed by the
+ * coefficients of its polynomials in evaluation form, as 64-bit words in
+ * the byte order of the host (little-endian on the supported platforms). A
+ * checksum of the entries ends the stream. The Shoup constants are not
+ * written; ReadRingGSWBTKey recomputes them.
+ */
+class RingGSWBTKeyWriter {
+ public:
+  /**
+   * Writes the header
+   *
+   * @param &os the output stream
+   * @param params a shared pointer to RingGSW scheme parameters
+   * @param dim1 first dimension of the key
+   * @param dim2 second dimension of the key
+   * @param dim3 third dimension of the key
+   */
+  RingGSWBTKeyWriter(std::ostream &os,
+                     const std::shared_ptr<RingGSWCryptoParams> params,
+                     uint32_t dim1, uint32_t dim2, uint32_t dim3);
+
+  /**
+   * Writes the next entry of the key
+   *
+   * @param &entry the entry; can be empty
+   */
+  void Write(const RingGSWCiphertext &entry);
+
+  /**
+   * Writes the checksum after the last entry
+   */
+  void Close();
+
+ private:
+  void WriteWords(const uint64_t *words, size_t count);
+
+  std::ostream &m_os;
+  uint32_t m_N;
+  uint64_t m_entries;
+  uint64_t m_written = 0;
+  uint64_t m_checksum;
+  std::vector<uint64_t> m_buffer;
+};
+
+/**
+ * Reads a refreshing key written by RingGSWBTKeyWriter, e.g., by the
+ * streaming RingGSWAccumulatorScheme::KeyGen
+ *
+ * @param &is the input stream
+ * @param params a shared pointer to RingGSW scheme parameters; must match
+ * the ring of the key
+ * @return a shared pointer to the refreshing key
+ */
+std::shared_ptr<RingGSWBTKey> ReadRingGSWBTKey(
+    std::istream &is, const std::shared_ptr<RingGSWCryptoParams> params);
+
+}  // namespace lbcrypto
+
+#endif
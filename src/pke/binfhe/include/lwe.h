@@ -34,6 +34,7 @@
 // #define BINFHE_DEBUG
 
 #include <memory>
+#include <vector>
 
 #include "lwecore.h"
 
@@ -107,12 +108,15 @@ class LWEEncryptionScheme {
    * @param params a shared pointer to LWE scheme parameters
    * @param sk new secret key
    * @param skN old secret key
+   * @param numThreads number of threads generating the key; 0 uses all
+   * OpenMP threads
    * @return a shared pointer to the switching key
    */
   std::shared_ptr<LWESwitchingKey> KeySwitchGen(
       const std::shared_ptr<LWECryptoParams> params,
       const std::shared_ptr<const LWEPrivateKeyImpl> sk,
-      const std::shared_ptr<const LWEPrivateKeyImpl> skN) const;
+      const std::shared_ptr<const LWEPrivateKeyImpl> skN,
+      uint32_t numThreads = 0) const;
 
   /**
    * Switches ciphertext from (Q,N) to (Q,n)
@@ -127,6 +131,22 @@ class LWEEncryptionScheme {
       const std::shared_ptr<LWESwitchingKey> K,
       const std::shared_ptr<const LWECiphertextImpl> ctQN) const;
 
+  /**
+   * Switches a ciphertext from (Q,N) to (q,n): modulus switching to qKS, key
+   * switching and modulus switching to q in one pass, without intermediate
+   * ciphertexts
+   *
+   * @param params a shared pointer to LWE scheme parameters
+   * @param K switching key
+   * @param &a first part of the input ciphertext, modulo Q
+   * @param &b second part of the input ciphertext, modulo Q
+   * @return a shared pointer to the resulting ciphertext
+   */
+  std::shared_ptr<LWECiphertextImpl> ModKeySwitch(
+      const std::shared_ptr<LWECryptoParams> params,
+      const std::shared_ptr<LWESwitchingKey> K, const NativeVector& a,
+      const NativeInteger& b) const;
+
   /**
    * Embeds a plaintext bit without noise or encryption
    *
@@ -137,6 +157,25 @@ class LWEEncryptionScheme {
   std::shared_ptr<LWECiphertextImpl> NoiselessEmbedding(
       const std::shared_ptr<LWECryptoParams> params,
       const LWEPlaintext& m) const;
+
+  /**
+   * Evaluates a linear layer on LWE ciphertexts:
+   * outputs[j] = biases[j] + sum_i W[j*inputs.size() + i] * inputs[i]
+   *
+   * The products are accumulated without modular reduction as long as they
+   * cannot overflow 64 bits, which needs a modulus of at most 32 bits.
+   *
+   * @param W weights reduced mod q, one row per output
+   * @param inputs input ciphertexts
+   * @param biases one ciphertext per output
+   * @param outputs resized to the number of outputs; existing ciphertexts
+   * are overwritten in place
+   */
+  void EvalLWELinear(
+      const NativeVector& W,
+      const std::vector<std::shared_ptr<LWECiphertextImpl>>& inputs,
+      const std::vector<LWECiphertextImpl>& biases,
+      std::vector<std::shared_ptr<LWECiphertextImpl>>* outputs) const;
 };
 
 }  // namespace lbcrypto
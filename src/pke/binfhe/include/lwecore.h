@@ -30,12 +30,15 @@
 
 #include "math/backend.h"
 #include "math/discretegaussiangenerator.h"
+#include "utils/alignedallocator.h"
 #include "utils/serializable.h"
 
 namespace lbcrypto {
 
 typedef int64_t LWEPlaintext;
 
+typedef uint64_t LWEPlaintextModulus;
+
 /**
  * @brief Class that stores all parameters for the LWE scheme
  */
@@ -254,12 +257,28 @@ class LWECiphertextImpl : public Serializable {
 
   const NativeInteger &GetA(std::size_t i) const { return m_a[i]; }
 
+  NativeVector &GetA() { return m_a; }
+
   const NativeInteger &GetB() const { return m_b; }
 
   void SetA(const NativeVector &a) { m_a = a; }
 
   void SetB(const NativeInteger &b) { m_b = b; }
 
+  /**
+   * Adds w times another ciphertext in place, without temporaries
+   *
+   * @param ct ciphertext to add, with the same modulus and dimension
+   * @param w scalar, reduced mod q
+   */
+  void AddScaledEq(const LWECiphertextImpl &ct, const NativeInteger &w) {
+    const NativeInteger &q = m_a.GetModulus();
+    NativeInteger wPrecon = w.PrepModMulConst(q);
+    for (size_t i = 0; i < m_a.GetLength(); ++i)
+      m_a[i].ModAddFastEq(ct.m_a[i].ModMulFastConst(w, q, wPrecon), q);
+    m_b.ModAddFastEq(ct.m_b.ModMulFastConst(w, q, wPrecon), q);
+  }
+
   bool operator==(const LWECiphertextImpl &other) const {
     return m_a == other.m_a && m_b == other.m_b;
   }
@@ -358,45 +377,184 @@ class LWEPrivateKeyImpl : public Serializable {
 
 /**
  * @brief Class that stores the LWE scheme switching key
+ *
+ * The key has an LWE ciphertext of dimension n for each coefficient i < N,
+ * digit value d < baseKS and digit position k < expKS. The ciphertexts are
+ * stored in one contiguous buffer as rows of n + 1 words (a, then b), indexed
+ * [i][d][k] and padded to a multiple of 64 bytes, so that the key switching
+ * walks the key with aligned vector loads and no pointer chasing.
+ *
+ * A key whose modulus fits in 32 bits is stored compactly, in 32-bit words,
+ * which halves its size and the memory traffic of the key switching.
  */
 class LWESwitchingKey : public Serializable {
  public:
+  typedef NativeInteger::Integer Word;
+
   LWESwitchingKey() {}
 
+  /**
+   * Allocates a key with all entries zero
+   *
+   * @param N dimension of the old secret key
+   * @param baseKS base of the digits
+   * @param expKS number of digits
+   * @param n dimension of the new secret key
+   * @param &modulus modulus of the key
+   */
+  LWESwitchingKey(uint32_t N, uint32_t baseKS, uint32_t expKS, uint32_t n,
+                  const NativeInteger &modulus) {
+    Allocate(N, baseKS, expKS, n, modulus);
+  }
+
   explicit LWESwitchingKey(
-      const std::vector<std::vector<std::vector<LWECiphertextImpl>>> &key)
-      : m_key(key) {}
+      const std::vector<std::vector<std::vector<LWECiphertextImpl>>> &key) {
+    SetElements(key);
+  }
 
-  explicit LWESwitchingKey(const LWESwitchingKey &rhs) {
-    this->m_key = rhs.m_key;
+  LWESwitchingKey(const LWESwitchingKey &rhs) = default;
+
+  LWESwitchingKey(LWESwitchingKey &&rhs) = default;
+
+  LWESwitchingKey &operator=(const LWESwitchingKey &rhs) = default;
+
+  LWESwitchingKey &operator=(LWESwitchingKey &&rhs) = default;
+
+  /**
+   * @return the ciphertexts of the key as nested vectors, indexed [i][d][k]
+   */
+  std::vector<std::vector<std::vector<LWECiphertextImpl>>> GetElements()
+      const {
+    std::vector<std::vector<std::vector<LWECiphertextImpl>>> key(
+        m_N, std::vector<std::vector<LWECiphertextImpl>>(
+                 m_baseKS, std::vector<LWECiphertextImpl>(m_expKS)));
+    for (uint32_t i = 0; i < m_N; i++)
+      for (uint32_t d = 0; d < m_baseKS; d++)
+        for (uint32_t k = 0; k < m_expKS; k++) {
+          NativeVector a(m_n, m_modulus);
+          for (uint32_t l = 0; l < m_n; l++) a[l] = GetWord(i, d, k, l);
+          key[i][d][k] = LWECiphertextImpl(
+              std::move(a), NativeInteger(GetWord(i, d, k, m_n)));
+        }
+    return key;
   }
 
-  explicit LWESwitchingKey(const LWESwitchingKey &&rhs) {
-    this->m_key = std::move(rhs.m_key);
+  void SetElements(
+      const std::vector<std::vector<std::vector<LWECiphertextImpl>>> &key) {
+    uint32_t N = key.size();
+    uint32_t baseKS = (N > 0) ? key[0].size() : 0;
+    uint32_t expKS = (baseKS > 0) ? key[0][0].size() : 0;
+    if (expKS == 0) {
+      Allocate(N, baseKS, expKS, 0, NativeInteger(0));
+      return;
+    }
+    const NativeVector &a0 = key[0][0][0].GetA();
+    Allocate(N, baseKS, expKS, a0.GetLength(), a0.GetModulus());
+    for (uint32_t i = 0; i < N; i++)
+      for (uint32_t d = 0; d < baseKS; d++)
+        for (uint32_t k = 0; k < expKS; k++) SetRow(i, d, k, key[i][d][k]);
   }
 
-  const LWESwitchingKey &operator=(const LWESwitchingKey &rhs) {
-    this->m_key = rhs.m_key;
-    return *this;
+  /**
+   * Sets one ciphertext of the key
+   *
+   * @param i coefficient of the old secret key
+   * @param d digit value
+   * @param k digit position
+   * @param &ct the ciphertext
+   */
+  void SetRow(uint32_t i, uint32_t d, uint32_t k, const LWECiphertextImpl &ct) {
+    if (ct.GetA().GetLength() != m_n)
+      PALISADE_THROW(config_error,
+                     "The switching key ciphertexts must have the same "
+                     "dimension");
+    if (m_compact) {
+      uint32_t *row = GetCompactRow(i, d, k);
+      for (uint32_t l = 0; l < m_n; l++) row[l] = ct.GetA()[l].ConvertToInt();
+      row[m_n] = ct.GetB().ConvertToInt();
+    } else {
+      Word *row = GetRow(i, d, k);
+      for (uint32_t l = 0; l < m_n; l++) row[l] = ct.GetA()[l].ConvertToInt();
+      row[m_n] = ct.GetB().ConvertToInt();
+    }
   }
 
-  const LWESwitchingKey &operator=(const LWESwitchingKey &&rhs) {
-    this->m_key = std::move(rhs.m_key);
-    return *this;
+  /**
+   * @return the words of the ciphertext [i][d][k]: a, then b; only for a key
+   * that is not compact
+   */
+  const Word *GetRow(uint32_t i, uint32_t d, uint32_t k) const {
+    return &m_data[RowIndex(i, d, k)];
   }
 
-  const std::vector<std::vector<std::vector<LWECiphertextImpl>>> &GetElements()
-      const {
-    return m_key;
+  Word *GetRow(uint32_t i, uint32_t d, uint32_t k) {
+    return &m_data[RowIndex(i, d, k)];
   }
 
-  void SetElements(
-      const std::vector<std::vector<std::vector<LWECiphertextImpl>>> &key) {
-    m_key = key;
+  /**
+   * @return the 32-bit words of the ciphertext [i][d][k]; only for a compact
+   * key
+   */
+  const uint32_t *GetCompactRow(uint32_t i, uint32_t d, uint32_t k) const {
+    return &m_data32[RowIndex(i, d, k)];
   }
 
+  uint32_t *GetCompactRow(uint32_t i, uint32_t d, uint32_t k) {
+    return &m_data32[RowIndex(i, d, k)];
+  }
+
+  /**
+   * @return true if the key is stored in 32-bit words
+   */
+  bool IsCompact() const { return m_compact; }
+
+  /**
+   * Changes the storage of the key; a key is made compact when it is
+   * allocated if its modulus fits in 32 bits
+   *
+   * @param compact true for 32-bit words, false for native words
+   */
+  void SetCompact(bool compact) {
+    if (compact == m_compact) return;
+    if (compact && (m_modulus.GetMSB() > 32))
+      PALISADE_THROW(config_error,
+                     "The modulus of the switching key does not fit in 32 "
+                     "bits");
+    uint32_t stride = Stride(m_n, compact);
+    size_t rows = (size_t)m_N * m_baseKS * m_expKS;
+    if (compact) {
+      m_data32.assign(rows * stride, 0);
+      for (size_t r = 0; r < rows; r++)
+        for (uint32_t l = 0; l <= m_n; l++)
+          m_data32[r * stride + l] = m_data[r * m_stride + l];
+      AlignedVector<Word>().swap(m_data);
+    } else {
+      m_data.assign(rows * stride, 0);
+      for (size_t r = 0; r < rows; r++)
+        for (uint32_t l = 0; l <= m_n; l++)
+          m_data[r * stride + l] = m_data32[r * m_stride + l];
+      AlignedVector<uint32_t>().swap(m_data32);
+    }
+    m_compact = compact;
+    m_stride = stride;
+  }
+
+  uint32_t GetN() const { return m_N; }
+  uint32_t GetBaseKS() const { return m_baseKS; }
+  uint32_t GetExpKS() const { return m_expKS; }
+  uint32_t Getn() const { return m_n; }
+  const NativeInteger &GetModulus() const { return m_modulus; }
+
+  /**
+   * @return the distance between two rows, in words of the storage
+   */
+  uint32_t GetStride() const { return m_stride; }
+
   bool operator==(const LWESwitchingKey &other) const {
-    return m_key == other.m_key;
+    return m_N == other.m_N && m_baseKS == other.m_baseKS &&
+           m_expKS == other.m_expKS && m_n == other.m_n &&
+           m_modulus == other.m_modulus && m_compact == other.m_compact &&
+           m_data == other.m_data && m_data32 == other.m_data32;
   }
 
   bool operator!=(const LWESwitchingKey &other) const {
@@ -405,7 +563,9 @@ class LWESwitchingKey : public Serializable {
 
   template <class Archive>
   void save(Archive &ar, std::uint32_t const version) const {
-    ar(::cereal::make_nvp("k", m_key));
+    std::vector<std::vector<std::vector<LWECiphertextImpl>>> key =
+        GetElements();
+    ar(::cereal::make_nvp("k", key));
   }
 
   template <class Archive>
@@ -416,14 +576,59 @@ class LWESwitchingKey : public Serializable {
                          " is from a later version of the library");
     }
 
-    ar(::cereal::make_nvp("k", m_key));
+    std::vector<std::vector<std::vector<LWECiphertextImpl>>> key;
+    ar(::cereal::make_nvp("k", key));
+    SetElements(key);
   }
 
   std::string SerializedObjectName() const { return "LWEPrivateKey"; }
   static uint32_t SerializedVersion() { return 1; }
 
  private:
-  std::vector<std::vector<std::vector<LWECiphertextImpl>>> m_key;
+  // rows of whole cache lines
+  static uint32_t Stride(uint32_t n, bool compact) {
+    const uint32_t lineWords =
+        64 / (compact ? sizeof(uint32_t) : sizeof(Word));
+    return (n + 1 + lineWords - 1) / lineWords * lineWords;
+  }
+
+  size_t RowIndex(uint32_t i, uint32_t d, uint32_t k) const {
+    return (((size_t)i * m_baseKS + d) * m_expKS + k) * m_stride;
+  }
+
+  Word GetWord(uint32_t i, uint32_t d, uint32_t k, uint32_t l) const {
+    return m_compact ? GetCompactRow(i, d, k)[l] : GetRow(i, d, k)[l];
+  }
+
+  void Allocate(uint32_t N, uint32_t baseKS, uint32_t expKS, uint32_t n,
+                const NativeInteger &modulus) {
+    m_N = N;
+    m_baseKS = baseKS;
+    m_expKS = expKS;
+    m_n = n;
+    m_modulus = modulus;
+    m_compact = (modulus.GetMSB() <= 32);
+    m_stride = Stride(n, m_compact);
+    size_t size = (size_t)N * baseKS * expKS * m_stride;
+    if (m_compact) {
+      m_data32.assign(size, 0);
+      AlignedVector<Word>().swap(m_data);
+    } else {
+      m_data.assign(size, 0);
+      AlignedVector<uint32_t>().swap(m_data32);
+    }
+  }
+
+  uint32_t m_N = 0;
+  uint32_t m_baseKS = 0;
+  uint32_t m_expKS = 0;
+  uint32_t m_n = 0;
+  uint32_t m_stride = 0;
+  NativeInteger m_modulus;
+  bool m_compact = false;
+  // the rows, in one of the two buffers
+  AlignedVector<Word> m_data;
+  AlignedVector<uint32_t> m_data32;
 };
 
 }  // namespace lbcrypto
@@ -39,8 +39,21 @@
 
 namespace lbcrypto {
 
-// enum for all supported binary gates
-enum BINGATE { OR, AND, NOR, NAND, XOR_FAST, XNOR_FAST, XOR, XNOR };
+// enum for all supported binary gates; MAJORITY, AND3 and OR3 take three
+// inputs, and the inputs of AND3 and OR3 are encrypted modulo 6 instead of 4
+enum BINGATE {
+  OR,
+  AND,
+  NOR,
+  NAND,
+  XOR_FAST,
+  XNOR_FAST,
+  XOR,
+  XNOR,
+  MAJORITY,
+  AND3,
+  OR3
+};
 
 // Two variants of FHEW are supported based on the bootstrapping technique used:
 // AP and GINX Please see "Bootstrapping in FHEW-like Cryptosystems" for details
@@ -120,14 +133,20 @@ class RingGSWCryptoParams : public Serializable {
       vTemp = vTemp.ModMul(NativeInteger(m_baseG), Q);
     }
 
-    // Sets the gate constants for supported binary operations
+    // Sets the gate constants for supported binary operations; the phases
+    // of the combined input in [c, c + q/2) are mapped to 0, the others to 1
     m_gateConst = {
         NativeInteger(5) * (q >> 3),  // OR
         NativeInteger(7) * (q >> 3),  // AND
         NativeInteger(1) * (q >> 3),  // NOR
         NativeInteger(3) * (q >> 3),  // NAND
         NativeInteger(5) * (q >> 3),  // XOR_FAST
-        NativeInteger(1) * (q >> 3)   // XNOR_FAST
+        NativeInteger(1) * (q >> 3),  // XNOR_FAST
+        NativeInteger(3) * (q >> 2),  // XOR
+        NativeInteger(1) * (q >> 2),  // XNOR
+        NativeInteger(7) * (q >> 3),  // MAJORITY
+        q * NativeInteger(11) / NativeInteger(12),  // AND3
+        q * NativeInteger(7) / NativeInteger(12)    // OR3
     };
 
     // Computes polynomials X^m - 1 that are needed in the accumulator for the
@@ -283,19 +302,23 @@ class RingGSWCiphertext : public Serializable {
 
   explicit RingGSWCiphertext(const RingGSWCiphertext& rhs) {
     this->m_elements = rhs.m_elements;
+    this->m_shoup = rhs.m_shoup;
   }
 
   explicit RingGSWCiphertext(const RingGSWCiphertext&& rhs) {
     this->m_elements = std::move(rhs.m_elements);
+    this->m_shoup = std::move(rhs.m_shoup);
   }
 
   const RingGSWCiphertext& operator=(const RingGSWCiphertext& rhs) {
     this->m_elements = rhs.m_elements;
+    this->m_shoup = rhs.m_shoup;
     return *this;
   }
 
   const RingGSWCiphertext& operator=(const RingGSWCiphertext&& rhs) {
     this->m_elements = rhs.m_elements;
+    this->m_shoup = rhs.m_shoup;
     return *this;
   }
 
@@ -305,6 +328,39 @@ class RingGSWCiphertext : public Serializable {
 
   void SetElements(const std::vector<std::vector<NativePoly>>& elements) {
     m_elements = elements;
+    m_shoup.clear();
+  }
+
+  /**
+   * Precomputes the Shoup constants floor(v * 2^w / Q) of all coefficients,
+   * used by the fused external product of the bootstrapping. The elements
+   * must be in Format::EVALUATION representation. The constants are not
+   * serialized; they are recomputed when the ciphertext is loaded.
+   */
+  void PrecomputeShoup() {
+    m_shoup.resize(m_elements.size());
+    for (uint32_t i = 0; i < m_elements.size(); i++) {
+      m_shoup[i].resize(m_elements[i].size());
+      for (uint32_t j = 0; j < m_elements[i].size(); j++) {
+        const NativeVector& v = m_elements[i][j].GetValues();
+        const NativeInteger& Q = v.GetModulus();
+        m_shoup[i][j] = NativeVector(v.GetLength(), Q);
+        for (uint32_t k = 0; k < v.GetLength(); k++)
+          m_shoup[i][j][k] = v[k].PrepModMulConst(Q);
+      }
+    }
+  }
+
+  /**
+   * @return true if the Shoup constants have been precomputed
+   */
+  bool HasShoup() const { return !m_shoup.empty(); }
+
+  /**
+   * @return the Shoup constants of element (i, j)
+   */
+  const NativeVector& GetShoup(uint32_t i, uint32_t j) const {
+    return m_shoup[i][j];
   }
 
   /**
@@ -345,6 +401,10 @@ class RingGSWCiphertext : public Serializable {
                          " is from a later version of the library");
     }
     ar(::cereal::make_nvp("elements", m_elements));
+    m_shoup.clear();
+    if (!m_elements.empty() && !m_elements[0].empty() &&
+        m_elements[0][0].GetFormat() == Format::EVALUATION)
+      PrecomputeShoup();
   }
 
   std::string SerializedObjectName() const { return "RingGSWCiphertext"; }
@@ -352,6 +412,8 @@ class RingGSWCiphertext : public Serializable {
 
  private:
   std::vector<std::vector<NativePoly>> m_elements;
+  // Shoup constants of m_elements, empty if not precomputed
+  std::vector<std::vector<NativeVector>> m_shoup;
 };
 
 /**
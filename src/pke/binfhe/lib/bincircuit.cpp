@@ -0,0 +1,184 @@
+// @file bincircuit.cpp - Implementation file for BinFHECircuit class
+//
+// @author TPOC: contact@palisade-crypto.org
+// @copyright Copyright (c) 2019, Duality Technologies Inc.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "bincircuit.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "utils/parallel.h"
+
+namespace lbcrypto {
+
+uint32_t BinFHECircuit::AddInput() {
+  Node node;
+  node.type = INPUT_NODE;
+  uint32_t id = AddNode(node);
+  m_inputs.push_back(id);
+  return id;
+}
+
+uint32_t BinFHECircuit::AddConstant(bool value) {
+  Node node;
+  node.type = CONSTANT_NODE;
+  node.value = value;
+  return AddNode(node);
+}
+
+uint32_t BinFHECircuit::AddNOT(uint32_t input) {
+  Node node;
+  node.type = NOT_NODE;
+  node.inputs = {input};
+  return AddNode(node);
+}
+
+uint32_t BinFHECircuit::AddGate(BINGATE gate, uint32_t input1,
+                                uint32_t input2) {
+  if ((gate == MAJORITY) || (gate == AND3) || (gate == OR3))
+    PALISADE_THROW(config_error, "This gate takes three inputs");
+  if (input1 == input2)
+    PALISADE_THROW(config_error,
+                   "ERROR: Please only use independent ciphertexts as inputs.");
+
+  Node node;
+  node.type = GATE_NODE;
+  node.gate = gate;
+  node.inputs = {input1, input2};
+  return AddNode(node);
+}
+
+uint32_t BinFHECircuit::AddGate(BINGATE gate,
+                                const std::vector<uint32_t> &inputs) {
+  if (inputs.size() == 2) return AddGate(gate, inputs[0], inputs[1]);
+
+  if ((gate != MAJORITY) && (gate != AND3) && (gate != OR3))
+    PALISADE_THROW(config_error, "This gate takes two inputs");
+  if (inputs.size() != 3)
+    PALISADE_THROW(config_error, "MAJORITY, AND3 and OR3 take three inputs");
+  if ((inputs[0] == inputs[1]) || (inputs[0] == inputs[2]) ||
+      (inputs[1] == inputs[2]))
+    PALISADE_THROW(config_error,
+                   "ERROR: Please only use independent ciphertexts as inputs.");
+
+  Node node;
+  node.type = GATE_NODE;
+  node.gate = gate;
+  node.inputs = inputs;
+  return AddNode(node);
+}
+
+void BinFHECircuit::AddOutput(uint32_t node) {
+  if (node >= m_nodes.size())
+    PALISADE_THROW(config_error, "The output node does not exist");
+  m_outputs.push_back(node);
+}
+
+uint32_t BinFHECircuit::GetNumBootstraps() const {
+  uint32_t count = 0;
+  for (const auto &level : m_gates) count += level.size();
+  return count;
+}
+
+uint32_t BinFHECircuit::AddNode(Node node) {
+  uint32_t id = m_nodes.size();
+
+  node.level = 0;
+  for (uint32_t input : node.inputs) {
+    if (input >= id)
+      PALISADE_THROW(config_error, "The input node does not exist");
+    node.level = std::max(node.level, m_nodes[input].level);
+  }
+
+  if (node.type == GATE_NODE) {
+    node.level++;
+    if (node.level == m_gates.size()) {
+      m_gates.emplace_back();
+      m_freeNodes.emplace_back();
+    }
+    m_gates[node.level].push_back(id);
+  } else if (node.type != INPUT_NODE) {
+    m_freeNodes[node.level].push_back(id);
+  }
+
+  m_nodes.push_back(std::move(node));
+  return id;
+}
+
+// The levels are evaluated in order. The bootstrapped gates of a level only
+// depend on nodes of lower levels and are split across threads; the NOT
+// gates and constants of the level are evaluated afterwards, in the order
+// they were added, since a NOT gate may take a gate of its own level.
+std::vector<std::shared_ptr<LWECiphertextImpl>> BinFHECircuit::Evaluate(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const RingGSWEvalKey &EK, const RingGSWAccumulatorScheme &scheme,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme,
+    const std::vector<std::shared_ptr<const LWECiphertextImpl>> &inputs)
+    const {
+  if ((GetNumBootstraps() > 0) &&
+      ((EK.BSkey == nullptr) || (EK.KSkey == nullptr))) {
+    std::string errMsg =
+        "Bootstrapping keys have not been generated. Please call BTKeyGen "
+        "before calling bootstrapping.";
+    PALISADE_THROW(config_error, errMsg);
+  }
+  if (inputs.size() != m_inputs.size())
+    PALISADE_THROW(config_error,
+                   "The number of ciphertexts does not match the inputs of the "
+                   "circuit");
+
+  std::vector<std::shared_ptr<const LWECiphertextImpl>> values(m_nodes.size());
+  for (uint32_t i = 0; i < m_inputs.size(); i++) values[m_inputs[i]] = inputs[i];
+
+  for (uint32_t level = 0; level < m_gates.size(); level++) {
+    const std::vector<uint32_t> &gates = m_gates[level];
+
+#pragma omp parallel for schedule(dynamic)
+    for (uint32_t k = 0; k < gates.size(); k++) {
+      const Node &node = m_nodes[gates[k]];
+      std::vector<std::shared_ptr<const LWECiphertextImpl>> cts(
+          node.inputs.size());
+      for (uint32_t i = 0; i < node.inputs.size(); i++)
+        cts[i] = values[node.inputs[i]];
+      values[gates[k]] = scheme.EvalBinGate(params, node.gate, EK, cts,
+                                            LWEscheme);
+    }
+
+    for (uint32_t id : m_freeNodes[level]) {
+      const Node &node = m_nodes[id];
+      if (node.type == NOT_NODE)
+        values[id] = scheme.EvalNOT(params, values[node.inputs[0]]);
+      else
+        values[id] =
+            LWEscheme->NoiselessEmbedding(params->GetLWEParams(), node.value);
+    }
+  }
+
+  std::vector<std::shared_ptr<LWECiphertextImpl>> outputs(m_outputs.size());
+  for (uint32_t i = 0; i < m_outputs.size(); i++)
+    outputs[i] = std::make_shared<LWECiphertextImpl>(*values[m_outputs[i]]);
+  return outputs;
+}
+
+}  // namespace lbcrypto
@@ -247,6 +247,20 @@ LWECiphertext BinFHEContext::EvalBinGate(const BINGATE gate,
                                       m_LWEscheme);
 }
 
+LWECiphertext BinFHEContext::EvalBinGate(
+    const BINGATE gate,
+    const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts) const {
+  return m_RingGSWscheme->EvalBinGate(m_params, gate, m_BTKey, cts,
+                                      m_LWEscheme);
+}
+
+LWECiphertext BinFHEContext::EvalThresholdGate(
+    const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts,
+    uint32_t threshold, LWEPlaintextModulus p) const {
+  return m_RingGSWscheme->EvalThresholdGate(m_params, m_BTKey, cts, threshold,
+                                            p, m_LWEscheme);
+}
+
 LWECiphertext BinFHEContext::Bootstrap(ConstLWECiphertext ct1) const {
   return m_RingGSWscheme->Bootstrap(m_params, m_BTKey, ct1, m_LWEscheme);
 }
@@ -255,6 +269,14 @@ LWECiphertext BinFHEContext::EvalNOT(ConstLWECiphertext ct) const {
   return m_RingGSWscheme->EvalNOT(m_params, ct);
 }
 
+std::vector<LWECiphertext> BinFHEContext::EvalCircuit(
+    const BinFHECircuit &circuit,
+    const std::vector<std::shared_ptr<const LWECiphertextImpl>> &inputs)
+    const {
+  return circuit.Evaluate(m_params, m_BTKey, *m_RingGSWscheme, m_LWEscheme,
+                          inputs);
+}
+
 LWECiphertext BinFHEContext::EvalConstant(bool value) const {
   return m_LWEscheme->NoiselessEmbedding(m_params->GetLWEParams(), value);
 
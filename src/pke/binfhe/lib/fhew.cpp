@@ -34,15 +34,25 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "fhew.h"
+#include <algorithm>
 #include <cstdint>
+#include <thread>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "keystream.h"
+#include "utils/parallel.h"
+#include "utils/stageprofiler.h"
 
 namespace lbcrypto {
 
 // Encryption as described in Section 5 of https://eprint.iacr.org/2014/816
 // skNTT corresponds to the secret key z
-std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::EncryptAP(
+void RingGSWAccumulatorScheme::EncryptAP(
     const std::shared_ptr<RingGSWCryptoParams> params, const NativePoly &skNTT,
-    const LWEPlaintext &m) const {
+    const LWEPlaintext &m, RingGSWCiphertext *result) const {
   NativeInteger Q = params->GetLWEParams()->GetQ();
   int64_t q = params->GetLWEParams()->Getq().ConvertToInt();
   uint32_t N = params->GetLWEParams()->GetN();
@@ -50,7 +60,7 @@ std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::EncryptAP(
   uint32_t digitsG2 = params->GetDigitsG2();
   const shared_ptr<ILNativeParams> polyParams = params->GetPolyParams();
 
-  auto result = std::make_shared<RingGSWCiphertext>(digitsG2, 2);
+  *result = RingGSWCiphertext(digitsG2, 2);
 
   DiscreteUniformGeneratorImpl<NativeVector> dug;
   dug.SetModulus(Q);
@@ -95,21 +105,19 @@ std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::EncryptAP(
     tempA[i].SetFormat(Format::EVALUATION);
     (*result)[i][1] += tempA[i] * skNTT;
   }
-
-  return result;
 }
 
 // Encryption for the GINX variant, as described in "Bootstrapping in FHEW-like
 // Cryptosystems"
-std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::EncryptGINX(
+void RingGSWAccumulatorScheme::EncryptGINX(
     const std::shared_ptr<RingGSWCryptoParams> params, const NativePoly &skNTT,
-    const LWEPlaintext &m) const {
+    const LWEPlaintext &m, RingGSWCiphertext *result) const {
   NativeInteger Q = params->GetLWEParams()->GetQ();
   uint32_t digitsG = params->GetDigitsG();
   uint32_t digitsG2 = params->GetDigitsG2();
   const shared_ptr<ILNativeParams> polyParams = params->GetPolyParams();
 
-  auto result = std::make_shared<RingGSWCiphertext>(digitsG2, 2);
+  *result = RingGSWCiphertext(digitsG2, 2);
 
   DiscreteUniformGeneratorImpl<NativeVector> dug;
   dug.SetModulus(Q);
@@ -139,216 +147,560 @@ std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::EncryptGINX(
     tempA[i].SetFormat(Format::EVALUATION);
     (*result)[i][1] += tempA[i] * skNTT;
   }
-
-  return result;
 }
 
-// wrapper for KeyGen methods
-RingGSWEvalKey RingGSWAccumulatorScheme::KeyGen(
-    const std::shared_ptr<RingGSWCryptoParams> params,
-    const std::shared_ptr<LWEEncryptionScheme> lwescheme,
-    const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk) const {
-  if (params->GetMethod() == AP)
-    return KeyGenAP(params, lwescheme, LWEsk);
-  else  // GINX
-    return KeyGenGINX(params, lwescheme, LWEsk);
+uint32_t RingGSWAccumulatorScheme::GetKeyGenThreads() const {
+#ifdef PARALLEL
+  uint32_t maxThreads = omp_get_max_threads();
+  return ((m_keyGenThreads == 0) || (m_keyGenThreads > maxThreads))
+             ? maxThreads
+             : m_keyGenThreads;
+#else
+  return 1;
+#endif
 }
 
-// Key generation as described in Section 4 of https://eprint.iacr.org/2014/816
-RingGSWEvalKey RingGSWAccumulatorScheme::KeyGenAP(
+// The switching key is generated first, so that the secret key skN is
+// released before the refreshing key is
+NativePoly RingGSWAccumulatorScheme::KeyGenSwitching(
     const std::shared_ptr<RingGSWCryptoParams> params,
     const std::shared_ptr<LWEEncryptionScheme> lwescheme,
-    const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk) const {
+    const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk,
+    RingGSWEvalKey *ek) const {
   const auto &LWEParams = params->GetLWEParams();
 
+  // the GINX keys handle ternary secrets only; checked here as exceptions
+  // cannot leave the parallel loops
+  if (params->GetMethod() == GINX) {
+    uint64_t q = LWEParams->Getq().ConvertToInt();
+    for (uint32_t i = 0; i < LWEParams->Getn(); ++i) {
+      uint64_t s = LWEsk->GetElement()[i].ConvertToInt();
+      if ((s > 1) && (s != q - 1)) {
+        std::string errMsg =
+            "ERROR: only ternary secret key distributions are supported.";
+        PALISADE_THROW(not_implemented_error, errMsg);
+      }
+    }
+  }
+
   const std::shared_ptr<const LWEPrivateKeyImpl> skN =
       lwescheme->KeyGenN(LWEParams);
 
-  RingGSWEvalKey ek;
-  ek.KSkey = lwescheme->KeySwitchGen(LWEParams, LWEsk, skN);
+  ek->KSkey = lwescheme->KeySwitchGen(LWEParams, LWEsk, skN,
+                                      GetKeyGenThreads());
 
   NativePoly skNPoly = NativePoly(params->GetPolyParams());
   skNPoly.SetValues(skN->GetElement(), Format::COEFFICIENT);
   skNPoly.SetFormat(Format::EVALUATION);
+  return skNPoly;
+}
 
-  NativeInteger q = LWEParams->Getq();
-  NativeInteger qHalf = q >> 1;
-  int32_t qInt = q.ConvertToInt();
-  uint32_t n = LWEParams->Getn();
-  uint32_t baseR = params->GetBaseR();
-  std::vector<NativeInteger> digitsR = params->GetDigitsR();
-
-  ek.BSkey = std::make_shared<RingGSWBTKey>(n, baseR, digitsR.size());
-
-#pragma omp parallel for
-  for (uint32_t i = 0; i < n; ++i)
-    for (uint32_t j = 1; j < baseR; ++j)
-      for (uint32_t k = 0; k < digitsR.size(); ++k) {
-        int32_t signedSK;
-        if (LWEsk->GetElement()[i] < qHalf)
-          signedSK = LWEsk->GetElement()[i].ConvertToInt();
-        else
-          signedSK = (int32_t)LWEsk->GetElement()[i].ConvertToInt() - qInt;
-        if (LWEsk->GetElement()[i] >= qHalf) signedSK -= qInt;
-        (*ek.BSkey)[i][j][k] = *(EncryptAP(
-            params, skNPoly,
-            signedSK * (int32_t)j * (int32_t)digitsR[k].ConvertToInt()));
-      }
+std::vector<uint32_t> RingGSWAccumulatorScheme::KeyDims(
+    const std::shared_ptr<RingGSWCryptoParams> params) {
+  uint32_t n = params->GetLWEParams()->Getn();
+  if (params->GetMethod() == AP)
+    return {n, params->GetBaseR(), (uint32_t)params->GetDigitsR().size()};
+  else  // GINX
+    return {1, 2, n};
+}
 
-  return ek;
+// Key generation as described in Section 4 of https://eprint.iacr.org/2014/816
+// for AP: entry (i, j, k) encrypts s_i * j * baseR^k. For GINX, the ternary
+// secrets are handled using signed mod 3 arithmetic; 0 -> {0,0}, 1 -> {1,0},
+// -1 -> {0,1}, and entry (0, j, i) is the j-th of them for s_i.
+void RingGSWAccumulatorScheme::EncryptKeyEntries(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const NativePoly &skNTT,
+    const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk, uint32_t begin,
+    const std::vector<RingGSWCiphertext *> &entries) const {
+  std::vector<uint32_t> dims = KeyDims(params);
+  const NativeVector &sk = LWEsk->GetElement();
+  int64_t q = params->GetLWEParams()->Getq().ConvertToInt();
+  int64_t qHalf = q >> 1;
+  const std::vector<NativeInteger> &digitsR = params->GetDigitsR();
+  uint32_t count = entries.size();
+  uint32_t threads = GetKeyGenThreads();
+
+#pragma omp parallel for num_threads(threads) schedule(dynamic)
+  for (uint32_t e = 0; e < count; ++e) {
+    uint32_t k = (begin + e) % dims[2];
+    uint32_t j = (begin + e) / dims[2] % dims[1];
+    uint32_t i = (begin + e) / dims[2] / dims[1];
+    RingGSWCiphertext *entry = entries[e];
+
+    if (params->GetMethod() == AP) {
+      if (j == 0) {
+        *entry = RingGSWCiphertext();
+        continue;
+      }
+      int64_t signedSK = sk[i].ConvertToInt();
+      if (signedSK >= qHalf) signedSK -= q;
+      EncryptAP(params, skNTT,
+                signedSK * (int64_t)j * (int64_t)digitsR[k].ConvertToInt(),
+                entry);
+    } else {  // GINX
+      int64_t s = sk[k].ConvertToInt();
+      if (s > qHalf) s -= q;
+      EncryptGINX(params, skNTT, (j == 0) ? (s == 1) : (s == -1), entry);
+    }
+    entry->PrecomputeShoup();
+  }
 }
 
-// Bootstrapping keys generation for the GINX variant, as described in
-// "Bootstrapping in FHEW-like Cryptosystems"
-RingGSWEvalKey RingGSWAccumulatorScheme::KeyGenGINX(
+// The entries are generated in blocks, with a progress report after each
+RingGSWEvalKey RingGSWAccumulatorScheme::KeyGen(
     const std::shared_ptr<RingGSWCryptoParams> params,
     const std::shared_ptr<LWEEncryptionScheme> lwescheme,
     const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk) const {
   RingGSWEvalKey ek;
-  const std::shared_ptr<const LWEPrivateKeyImpl> skN =
-      lwescheme->KeyGenN(params->GetLWEParams());
+  NativePoly skNPoly = KeyGenSwitching(params, lwescheme, LWEsk, &ek);
+
+  std::vector<uint32_t> dims = KeyDims(params);
+  ek.BSkey = std::make_shared<RingGSWBTKey>(dims[0], dims[1], dims[2]);
+
+  std::vector<RingGSWCiphertext *> entries;
+  for (uint32_t i = 0; i < dims[0]; ++i)
+    for (uint32_t j = 0; j < dims[1]; ++j)
+      for (uint32_t k = 0; k < dims[2]; ++k)
+        entries.push_back(&(*ek.BSkey)[i][j][k]);
+
+  uint32_t total = entries.size();
+  uint32_t block = KEYGEN_BLOCK * GetKeyGenThreads();
+  for (uint32_t begin = 0; begin < total; begin += block) {
+    uint32_t end = std::min(total, begin + block);
+    EncryptKeyEntries(params, skNPoly, LWEsk, begin,
+                      std::vector<RingGSWCiphertext *>(
+                          entries.begin() + begin, entries.begin() + end));
+    if (m_keyGenProgress) m_keyGenProgress(end, total);
+  }
 
-  ek.KSkey = lwescheme->KeySwitchGen(params->GetLWEParams(), LWEsk, skN);
+  return ek;
+}
 
-  NativePoly skNPoly = NativePoly(params->GetPolyParams());
-  skNPoly.SetValues(skN->GetElement(), Format::COEFFICIENT);
-  skNPoly.SetFormat(Format::EVALUATION);
+// Only one block of entries is in memory; it is reused for every block
+RingGSWEvalKey RingGSWAccumulatorScheme::KeyGen(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const std::shared_ptr<LWEEncryptionScheme> lwescheme,
+    const std::shared_ptr<const LWEPrivateKeyImpl> LWEsk,
+    std::ostream &os) const {
+  RingGSWEvalKey ek;
+  NativePoly skNPoly = KeyGenSwitching(params, lwescheme, LWEsk, &ek);
+
+  std::vector<uint32_t> dims = KeyDims(params);
+  RingGSWBTKeyWriter writer(os, params, dims[0], dims[1], dims[2]);
+
+  uint32_t total = dims[0] * dims[1] * dims[2];
+  uint32_t block = KEYGEN_BLOCK * GetKeyGenThreads();
+  std::vector<RingGSWCiphertext> buffer(std::min(total, block));
+  for (uint32_t begin = 0; begin < total; begin += block) {
+    uint32_t end = std::min(total, begin + block);
+    std::vector<RingGSWCiphertext *> entries;
+    for (uint32_t e = begin; e < end; ++e)
+      entries.push_back(&buffer[e - begin]);
+    EncryptKeyEntries(params, skNPoly, LWEsk, begin, entries);
+    for (auto entry : entries) writer.Write(*entry);
+    if (m_keyGenProgress) m_keyGenProgress(end, total);
+  }
+  writer.Close();
 
-  uint64_t q = params->GetLWEParams()->Getq().ConvertToInt();
-  uint32_t n = params->GetLWEParams()->Getn();
+  return ek;
+}
 
-  ek.BSkey = std::make_shared<RingGSWBTKey>(1, 2, n);
-
-  int64_t qHalf = (q >> 1);
-
-  // handles ternary secrets using signed mod 3 arithmetic; 0 -> {0,0}, 1 ->
-  // {1,0}, -1 -> {0,1}
-#pragma omp parallel for
-  for (uint32_t i = 0; i < n; ++i) {
-    int64_t s = LWEsk->GetElement()[i].ConvertToInt();
-    if (s > qHalf) s -= q;
-    switch (s) {
-      case 0:
-        (*ek.BSkey)[0][0][i] = *(EncryptGINX(params, skNPoly, 0));
-        (*ek.BSkey)[0][1][i] = *(EncryptGINX(params, skNPoly, 0));
-        break;
-      case 1:
-        (*ek.BSkey)[0][0][i] = *(EncryptGINX(params, skNPoly, 1));
-        (*ek.BSkey)[0][1][i] = *(EncryptGINX(params, skNPoly, 0));
-        break;
-      case -1:
-        (*ek.BSkey)[0][0][i] = *(EncryptGINX(params, skNPoly, 0));
-        (*ek.BSkey)[0][1][i] = *(EncryptGINX(params, skNPoly, 1));
-        break;
-      default:
-        std::string errMsg =
-            "ERROR: only ternary secret key distributions are supported.";
-        PALISADE_THROW(not_implemented_error, errMsg);
+// Constants of one signed digit decomposition pass
+typedef struct {
+  NativeInteger::SignedNativeInt Q;
+  NativeInteger::SignedNativeInt QHalf;
+  NativeInteger::SignedNativeInt baseG;
+  // (baseG >> 1) - 1, for variant B
+  NativeInteger::SignedNativeInt baseGdiv2;
+  // digit bits and MaxBits - digit bits, for variant A
+  int gBits;
+  int gBitsMaxBits;
+} DecomposeConsts;
+
+#if NATIVEINT == 64 && defined(__AVX2__) && !defined(__AVX512F__)
+// arithmetic right shift of signed 64-bit lanes, which AVX2 does not have
+static inline __m256i SraEpi64(__m256i x, __m128i count) {
+  __m256i sign = _mm256_cmpgt_epi64(_mm256_setzero_si256(), x);
+  return _mm256_xor_si256(_mm256_srl_epi64(_mm256_xor_si256(x, sign), count),
+                          sign);
+}
+#endif
+
+// One digit of a signed digit decomposition for N coefficients. The values
+// are read from src, centered to (-Q/2, Q/2] first if center is set. The
+// digit r, in [-baseG/2, baseG/2), is written to out as r mod Q and the
+// remaining value (d - r) / baseG to rest, unless rest is null. src may be
+// the same buffer as out.
+//
+// Variant A extracts the digit with a pair of shifts, variant B with a mask
+// and a comparison; variant A appears to give slightly better performance.
+template <bool VARIANT_B>
+static void DecomposeDigit(const NativeInteger *src, NativeInteger *out,
+                           NativeInteger *rest, uint32_t N, bool center,
+                           const DecomposeConsts &c) {
+  typedef NativeInteger::Integer Word;
+  typedef NativeInteger::SignedNativeInt SWord;
+  const Word *in = reinterpret_cast<const Word *>(src);
+  Word *o = reinterpret_cast<Word *>(out);
+  Word *r = reinterpret_cast<Word *>(rest);
+
+  uint32_t k = 0;
+#if NATIVEINT == 64 && defined(__AVX512F__)
+  const __m512i vQ = _mm512_set1_epi64(c.Q);
+  const __m512i vQHalf = _mm512_set1_epi64(c.QHalf);
+  const __m512i vBase = _mm512_set1_epi64(c.baseG);
+  const __m512i vMask = _mm512_set1_epi64(c.baseG - 1);
+  const __m512i vHalf = _mm512_set1_epi64(c.baseGdiv2);
+  const __m512i vZero = _mm512_setzero_si512();
+  const __m128i gBits = _mm_cvtsi32_si128(c.gBits);
+  const __m128i gBitsMaxBits = _mm_cvtsi32_si128(c.gBitsMaxBits);
+  for (; k + 8 <= N; k += 8) {
+    __m512i d = _mm512_loadu_si512(reinterpret_cast<const void *>(in + k));
+    if (center)
+      d = _mm512_mask_sub_epi64(d, _mm512_cmpge_epi64_mask(d, vQHalf), d, vQ);
+    __m512i digit;
+    if (VARIANT_B) {
+      digit = _mm512_and_si512(d, vMask);
+      digit = _mm512_mask_sub_epi64(
+          digit, _mm512_cmpgt_epi64_mask(digit, vHalf), digit, vBase);
+    } else {
+      digit = _mm512_sra_epi64(_mm512_sll_epi64(d, gBitsMaxBits), gBitsMaxBits);
     }
+    if (r != nullptr)
+      _mm512_storeu_si512(reinterpret_cast<void *>(r + k),
+                          _mm512_sra_epi64(_mm512_sub_epi64(d, digit), gBits));
+    digit = _mm512_mask_add_epi64(
+        digit, _mm512_cmplt_epi64_mask(digit, vZero), digit, vQ);
+    _mm512_storeu_si512(reinterpret_cast<void *>(o + k), digit);
   }
+#elif NATIVEINT == 64 && defined(__AVX2__)
+  const __m256i vQ = _mm256_set1_epi64x(c.Q);
+  const __m256i vQHalfM1 = _mm256_set1_epi64x(c.QHalf - 1);
+  const __m256i vBase = _mm256_set1_epi64x(c.baseG);
+  const __m256i vMask = _mm256_set1_epi64x(c.baseG - 1);
+  const __m256i vHalf = _mm256_set1_epi64x(c.baseGdiv2);
+  const __m256i vZero = _mm256_setzero_si256();
+  const __m128i gBits = _mm_cvtsi32_si128(c.gBits);
+  const __m128i gBitsMaxBits = _mm_cvtsi32_si128(c.gBitsMaxBits);
+  for (; k + 4 <= N; k += 4) {
+    __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + k));
+    if (center)
+      d = _mm256_sub_epi64(
+          d, _mm256_and_si256(_mm256_cmpgt_epi64(d, vQHalfM1), vQ));
+    __m256i digit;
+    if (VARIANT_B) {
+      digit = _mm256_and_si256(d, vMask);
+      digit = _mm256_sub_epi64(
+          digit, _mm256_and_si256(_mm256_cmpgt_epi64(digit, vHalf), vBase));
+    } else {
+      digit = SraEpi64(_mm256_sll_epi64(d, gBitsMaxBits), gBitsMaxBits);
+    }
+    if (r != nullptr)
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(r + k),
+                          SraEpi64(_mm256_sub_epi64(d, digit), gBits));
+    digit = _mm256_add_epi64(
+        digit, _mm256_and_si256(_mm256_cmpgt_epi64(vZero, digit), vQ));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(o + k), digit);
+  }
+#endif
+  for (; k < N; k++) {
+    SWord d = (SWord)in[k];
+    if (center && d >= c.QHalf) d -= c.Q;
+    SWord digit;
+    if (VARIANT_B) {
+      digit = d & (c.baseG - 1);
+      if (digit > c.baseGdiv2) digit -= c.baseG;
+    } else {
+      digit = d << c.gBitsMaxBits;
+      digit >>= c.gBitsMaxBits;
+    }
+    if (r != nullptr) r[k] = (Word)((d - digit) >> c.gBits);
+    o[k] = (Word)((digit < 0) ? digit + c.Q : digit);
+  }
+}
 
-  return ek;
+static DecomposeConsts GetDecomposeConsts(
+    const std::shared_ptr<RingGSWCryptoParams> params) {
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  DecomposeConsts c;
+  c.Q = Q.ConvertToInt();
+  c.QHalf = (Q >> 1).ConvertToInt();
+  c.baseG = params->GetBaseG();
+  c.baseGdiv2 = (c.baseG >> 1) - 1;
+  c.gBits = (int)std::log2(c.baseG);
+  c.gBitsMaxBits = NativeInteger::MaxBits() - c.gBits;
+  return c;
+}
+
+// Decomposes component j of an RLWE ciphertext into the outputs j + 2l.
+// The digits are produced one pass per digit over raw buffers: digit l is
+// written to its output polynomial, and the remaining value is kept in the
+// output polynomial of digit l + 1 until the next pass overwrites it.
+static void DecomposeComponent(const DecomposeConsts &c, const NativePoly &input,
+                               uint32_t j, std::vector<NativePoly> *output) {
+  uint32_t N = input.GetLength();
+  uint32_t digitsG = output->size() >> 1;
+  const NativeInteger *src = &input[0];
+  for (uint32_t l = 0; l < digitsG; l++) {
+    NativeInteger *out = &(*output)[j + 2 * l][0];
+    NativeInteger *rest =
+        (l + 1 < digitsG) ? &(*output)[j + 2 * (l + 1)][0] : nullptr;
+#if defined(BINFHE_DECOMPOSE_VARIANT_B)
+    DecomposeDigit<true>(src, out, rest, N, l == 0, c);
+#else
+    DecomposeDigit<false>(src, out, rest, N, l == 0, c);
+#endif
+    src = rest;
+  }
 }
 
 // SignedDigitDecompose is a bottleneck operation
-// There are two approaches to do it.
-// The current approach appears to give the best performance
-// results. The two variants are labeled A and B.
+// There are two approaches to do it (see DecomposeDigit); variant A is used
+// unless BINFHE_DECOMPOSE_VARIANT_B is defined.
 void RingGSWAccumulatorScheme::SignedDigitDecompose(
     const std::shared_ptr<RingGSWCryptoParams> params,
     const std::vector<NativePoly> &input,
     std::vector<NativePoly> *output) const {
-  uint32_t N = params->GetLWEParams()->GetN();
-  uint32_t digitsG = params->GetDigitsG();
-  NativeInteger Q = params->GetLWEParams()->GetQ();
-  NativeInteger QHalf = Q >> 1;
-  NativeInteger::SignedNativeInt Q_int = Q.ConvertToInt();
+  DecomposeConsts c = GetDecomposeConsts(params);
+  for (uint32_t j = 0; j < 2; j++) DecomposeComponent(c, input[j], j, output);
+}
 
-  NativeInteger::SignedNativeInt baseG =
-      NativeInteger(params->GetBaseG()).ConvertToInt();
+BlindRotateWorkspace::BlindRotateWorkspace(
+    const std::shared_ptr<RingGSWCryptoParams> params)
+    : ct(2, NativePoly(params->GetPolyParams(), Format::EVALUATION, true)),
+      dct(params->GetDigitsG2(),
+          NativePoly(params->GetPolyParams(), Format::EVALUATION, true)),
+      prod(2, NativePoly(params->GetPolyParams(), Format::EVALUATION, true)),
+      mu(params->GetLWEParams()->GetQ().ComputeMu()) {}
+
+bool BlindRotateWorkspace::Matches(
+    const std::shared_ptr<RingGSWCryptoParams> params) const {
+  return dct.size() == params->GetDigitsG2() &&
+         *dct[0].GetParams() == *params->GetPolyParams();
+}
 
-  NativeInteger::SignedNativeInt d = 0;
+BlindRotateWorkspace &RingGSWAccumulatorScheme::GetWorkspace(
+    const std::shared_ptr<RingGSWCryptoParams> params) {
+  thread_local std::unique_ptr<BlindRotateWorkspace> workspace;
+  if ((workspace == nullptr) || !workspace->Matches(params))
+    workspace = make_unique<BlindRotateWorkspace>(params);
+  return *workspace;
+}
 
-  NativeInteger::SignedNativeInt gBits =
-      (NativeInteger::SignedNativeInt)std::log2(baseG);
+// *r = a * b, or *r += a * b if ADD, for polynomials in evaluation form;
+// only the coefficients in [begin, end) are computed
+template <bool ADD>
+static inline void MulAcc(NativePoly *r, const NativePoly &a,
+                          const NativePoly &b, const NativeInteger &Q,
+                          const NativeInteger &mu, uint32_t begin,
+                          uint32_t end) {
+  NativeInteger *rv = &(*r)[0];
+  const NativeInteger *av = &a[0];
+  const NativeInteger *bv = &b[0];
+  for (uint32_t k = begin; k < end; k++) {
+    NativeInteger t = av[k].ModMulFast(bv[k], Q, mu);
+    rv[k] = ADD ? rv[k].ModAddFast(t, Q) : t;
+  }
+}
 
-  // VARIANT A
-  NativeInteger::SignedNativeInt gBitsMaxBits =
-      NativeInteger::MaxBits() - gBits;
+#if NATIVEINT == 64 && defined(HAVE_INT128)
+// ws->prod[j] = sum_l ws->dct[l] * input[l][j] using the Shoup constants of
+// input, for the coefficients in [begin, end); each pass over the
+// coefficients handles one digit for both output components. A Shoup
+// product is in [0, 2Q), and the sums are kept in [0, 2Q) by a conditional
+// subtraction and fully reduced at the end, so Q must be below 2^62.
+static void ShoupExternalProduct(const RingGSWCiphertext &input,
+                                 BlindRotateWorkspace *ws, uint32_t begin,
+                                 uint32_t end) {
+  typedef NativeInteger::Integer Word;
+  typedef NativeInteger::DNativeInt DWord;
+  const uint32_t wordBits = sizeof(Word) * 8;
+  uint32_t digitsG2 = ws->dct.size();
+  Word Q = ws->dct[0].GetModulus().ConvertToInt();
+  Word Q2 = Q << 1;
+
+  Word *r0 = reinterpret_cast<Word *>(&ws->prod[0][0]);
+  Word *r1 = reinterpret_cast<Word *>(&ws->prod[1][0]);
+  for (uint32_t l = 0; l < digitsG2; l++) {
+    const Word *d = reinterpret_cast<const Word *>(&ws->dct[l][0]);
+    const Word *b0 = reinterpret_cast<const Word *>(&input[l][0][0]);
+    const Word *b1 = reinterpret_cast<const Word *>(&input[l][1][0]);
+    const Word *p0 = reinterpret_cast<const Word *>(&input.GetShoup(l, 0)[0]);
+    const Word *p1 = reinterpret_cast<const Word *>(&input.GetShoup(l, 1)[0]);
+    for (uint32_t k = begin; k < end; k++) {
+      Word a = d[k];
+      Word t0 = a * b0[k] - (Word)(((DWord)a * p0[k]) >> wordBits) * Q;
+      Word t1 = a * b1[k] - (Word)(((DWord)a * p1[k]) >> wordBits) * Q;
+      if (l > 0) {
+        t0 += r0[k];
+        t1 += r1[k];
+        t0 = (t0 >= Q2) ? t0 - Q2 : t0;
+        t1 = (t1 >= Q2) ? t1 - Q2 : t1;
+      }
+      r0[k] = t0;
+      r1[k] = t1;
+    }
+  }
+  for (uint32_t k = begin; k < end; k++) {
+    r0[k] = (r0[k] >= Q) ? r0[k] - Q : r0[k];
+    r1[k] = (r1[k] >= Q) ? r1[k] - Q : r1[k];
+  }
+}
+#endif
+
+// Sets the coefficients [begin, end) of ws.prod to the external product of
+// the digits in ws.dct with input
+static void DigitProduct(const std::shared_ptr<RingGSWCryptoParams> params,
+                         const RingGSWCiphertext &input,
+                         BlindRotateWorkspace *ws, uint32_t begin,
+                         uint32_t end) {
+  uint32_t digitsG2 = params->GetDigitsG2();
+  NativeInteger Q = params->GetLWEParams()->GetQ();
 
-  // VARIANT B
-  // NativeInteger::SignedNativeInt gminus1 = (1 << gBits) - 1;
-  // NativeInteger::SignedNativeInt baseGdiv2 =
-  // (baseG >> 1)-1;
+#if NATIVEINT == 64 && defined(HAVE_INT128)
+  if (input.HasShoup() && Q.GetMSB() <= 62) {
+    ShoupExternalProduct(input, ws, begin, end);
+    return;
+  }
+#endif
 
-  // Signed digit decomposition
   for (uint32_t j = 0; j < 2; j++) {
-    for (uint32_t k = 0; k < N; k++) {
-      NativeInteger t = input[j][k];
-      if (t < QHalf)
-        d += t.ConvertToInt();
-      else
-        d += (NativeInteger::SignedNativeInt)t.ConvertToInt() - Q_int;
-
-      for (uint32_t l = 0; l < digitsG; l++) {
-        // remainder is signed
-
-        // This approach gives a slightly better performance
-        // VARIANT A
-        NativeInteger::SignedNativeInt r = d << gBitsMaxBits;
-        r >>= gBitsMaxBits;
-
-        // VARIANT B
-        // NativeInteger::SignedNativeInt r = d & gminus1;
-        // if (r > baseGdiv2) r -= baseG;
-
-        d -= r;
-        d >>= gBits;
-
-        if (r >= 0)
-          (*output)[j + 2 * l][k] += NativeInteger(r);
-        else
-          (*output)[j + 2 * l][k] += NativeInteger(r + Q_int);
-      }
-      d = 0;
-    }
+    MulAcc<false>(&ws->prod[j], ws->dct[0], input[0][j], Q, ws->mu, begin,
+                  end);
+    for (uint32_t l = 1; l < digitsG2; l++)
+      MulAcc<true>(&ws->prod[j], ws->dct[l], input[l][j], Q, ws->mu, begin,
+                   end);
   }
 }
 
-// AP Accumulation as described in "Bootstrapping in FHEW-like Cryptosystems"
-void RingGSWAccumulatorScheme::AddToACCAP(
-    const std::shared_ptr<RingGSWCryptoParams> params,
-    const RingGSWCiphertext &input,
-    std::shared_ptr<RingGSWCiphertext> acc) const {
+// Decomposes the accumulator into ws.dct in evaluation form and sets
+// ws.prod to the external product of the digits with input
+static void ExternalProduct(const RingGSWAccumulatorScheme &scheme,
+                            const std::shared_ptr<RingGSWCryptoParams> params,
+                            const RingGSWCiphertext &input,
+                            BlindRotateWorkspace *ws, bool decompose) {
   uint32_t digitsG2 = params->GetDigitsG2();
-  const shared_ptr<ILNativeParams> polyParams = params->GetPolyParams();
 
-  std::vector<NativePoly> ct = acc->GetElements()[0];
-  std::vector<NativePoly> dct(digitsG2);
+  if (decompose) {
+    // calls 2 NTTs
+    for (uint32_t i = 0; i < 2; i++) ws->ct[i].SetFormat(Format::COEFFICIENT);
 
-  // initialize dct to zeros
-  for (uint32_t i = 0; i < digitsG2; i++)
-    dct[i] = NativePoly(polyParams, Format::COEFFICIENT, true);
+    scheme.SignedDigitDecompose(params, ws->ct, &ws->dct);
 
-  // calls 2 NTTs
-  for (uint32_t i = 0; i < 2; i++) ct[i].SetFormat(Format::COEFFICIENT);
+    // calls digitsG2 NTTs
+    for (uint32_t l = 0; l < digitsG2; l++) {
+      ws->dct[l].OverrideFormat(Format::COEFFICIENT);
+      ws->dct[l].SetFormat(Format::EVALUATION);
+    }
+  }
 
-  SignedDigitDecompose(params, ct, &dct);
+  DigitProduct(params, input, ws, 0, params->GetLWEParams()->GetN());
+}
 
-  // calls digitsG2 NTTs
-  for (uint32_t j = 0; j < digitsG2; j++) dct[j].SetFormat(Format::EVALUATION);
+// Accumulator update split across the threads of a team, in up to three
+// rounds: the two components are converted to coefficient form and
+// decomposed, the digits are converted back to evaluation form, and the
+// products are computed over contiguous ranges of coefficients. With two
+// threads each thread converts the digits of its own component, so the
+// first two rounds are merged. For AP (monomials == nullptr) the
+// accumulator is replaced by the product with inputs[0]; for GINX the
+// product with inputs[k] times monomials[k] is added for each k.
+static void TeamExternalProduct(
+    SpinTeam *team, const std::shared_ptr<RingGSWCryptoParams> params,
+    const RingGSWCiphertext *const *inputs, const NativePoly *const *monomials,
+    uint32_t count, BlindRotateWorkspace *ws,
+    std::shared_ptr<RingGSWCiphertext> acc) {
+  uint32_t T = team->GetNumThreads();
+  uint32_t N = params->GetLWEParams()->GetN();
+  uint32_t digitsG2 = params->GetDigitsG2();
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  DecomposeConsts c = GetDecomposeConsts(params);
+
+  auto decompose = [&](uint32_t t) {
+    for (uint32_t j = t; j < 2; j += T) {
+      ws->ct[j] = (*acc)[0][j];
+      ws->ct[j].SetFormat(Format::COEFFICIENT);
+      DecomposeComponent(c, ws->ct[j], j, &ws->dct);
+      if (T > 2) continue;
+      for (uint32_t l = j; l < digitsG2; l += 2) {
+        ws->dct[l].OverrideFormat(Format::COEFFICIENT);
+        ws->dct[l].SetFormat(Format::EVALUATION);
+      }
+    }
+  };
+  team->Run(decompose);
+
+  if (T > 2) {
+    auto transform = [&](uint32_t t) {
+      for (uint32_t l = t; l < digitsG2; l += T) {
+        ws->dct[l].OverrideFormat(Format::COEFFICIENT);
+        ws->dct[l].SetFormat(Format::EVALUATION);
+      }
+    };
+    team->Run(transform);
+  }
 
-  // acc = dct * input (matrix product);
-  // uses in-place * operators for the last call to dct[i] to gain performance
-  // improvement
-  for (uint32_t j = 0; j < 2; j++) {
-    (*acc)[0][j].SetValuesToZero();
-    for (uint32_t l = 0; l < digitsG2; l++) {
-      if (j == 0)
-        (*acc)[0][j] += dct[l] * input[l][j];
-      else
-        (*acc)[0][j] += (dct[l] *= input[l][j]);
+  // the ranges are whole cache lines, so no two threads write to the same one
+  auto multiply = [&](uint32_t t) {
+    uint32_t lines = (N + 7) >> 3;
+    uint32_t begin = std::min(N, (t * lines / T) << 3);
+    uint32_t end = std::min(N, ((t + 1) * lines / T) << 3);
+    for (uint32_t k = 0; k < count; k++) {
+      DigitProduct(params, *inputs[k], ws, begin, end);
+      for (uint32_t j = 0; j < 2; j++) {
+        NativePoly &r = (*acc)[0][j];
+        if (monomials != nullptr)
+          MulAcc<true>(&r, ws->prod[j], *monomials[k], Q, ws->mu, begin, end);
+        else
+          std::copy(&ws->prod[j][0] + begin, &ws->prod[j][0] + end, &r[0] + begin);
+      }
     }
+  };
+  team->Run(multiply);
+}
+
+// AP Accumulation as described in "Bootstrapping in FHEW-like Cryptosystems"
+void RingGSWAccumulatorScheme::AddToACCAP(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const RingGSWCiphertext &input, std::shared_ptr<RingGSWCiphertext> acc,
+    SpinTeam *team) const {
+  BlindRotateWorkspace &ws = GetWorkspace(params);
+  if (team != nullptr) {
+    const RingGSWCiphertext *inputs[1] = {&input};
+    TeamExternalProduct(team, params, inputs, nullptr, 1, &ws, acc);
+    return;
+  }
+
+  for (uint32_t i = 0; i < 2; i++) ws.ct[i] = (*acc)[0][i];
+
+  // acc = dct * input (matrix product)
+  ExternalProduct(*this, params, input, &ws, true);
+  for (uint32_t j = 0; j < 2; j++) (*acc)[0][j] = ws.prod[j];
+}
+
+// *acc += (X^k - 1) * p for polynomials in coefficient form, k in [0, 2N).
+// Coefficient j of X^k * p is p[j - k], negated once for each wrap around N.
+static void AddRotation(NativePoly *acc, const NativePoly &p, uint32_t k,
+                        const NativeInteger &Q) {
+  typedef NativeInteger::Integer Word;
+  uint32_t N = p.GetLength();
+  Word q = Q.ConvertToInt();
+  Word *r = reinterpret_cast<Word *>(&(*acc)[0]);
+  const Word *v = reinterpret_cast<const Word *>(&p[0]);
+  auto add = [q](Word x, Word y) { return (x >= q - y) ? x - (q - y) : x + y; };
+  auto sub = [q](Word x, Word y) { return (x >= y) ? x - y : x + (q - y); };
+
+  // X^k = -X^(k - N) for k >= N
+  bool negate = k >= N;
+  if (negate) k -= N;
+  for (uint32_t j = 0; j < k; j++) {
+    Word t = negate ? add(r[j], v[j + N - k]) : sub(r[j], v[j + N - k]);
+    r[j] = sub(t, v[j]);
+  }
+  for (uint32_t j = k; j < N; j++) {
+    Word t = negate ? sub(r[j], v[j - k]) : add(r[j], v[j - k]);
+    r[j] = sub(t, v[j]);
   }
 }
 
@@ -356,31 +708,20 @@ void RingGSWAccumulatorScheme::AddToACCAP(
 // Added ternary MUX introduced in paper https://eprint.iacr.org/2022/074.pdf section 5
 // We optimize the algorithm by multiplying the monomial after the external product
 // This reduces the number of polynomial multiplications which further reduces the runtime
+// All intermediate polynomials live in the workspace of the calling thread.
 void RingGSWAccumulatorScheme::AddToACCGINX(
     const std::shared_ptr<RingGSWCryptoParams> params,
     const RingGSWCiphertext &input1, const RingGSWCiphertext &input2, 
     const NativeInteger &a,
-    std::shared_ptr<RingGSWCiphertext> acc) const {
+    std::shared_ptr<RingGSWCiphertext> acc, SpinTeam *team) const {
   // cycltomic order
   uint32_t m = 2 * params->GetLWEParams()->GetN();
-  uint32_t digitsG2 = params->GetDigitsG2();
   // int64_t q = params->GetLWEParams()->Getq().ConvertToInt();
   int64_t q = m;
-  const shared_ptr<ILNativeParams> polyParams = params->GetPolyParams();
-
-  std::vector<NativePoly> ct = acc->GetElements()[0];
-  std::vector<NativePoly> dct(digitsG2);
-
-  // initialize dct to zeros
-  for (uint32_t i = 0; i < digitsG2; i++)
-    dct[i] = NativePoly(polyParams, Format::COEFFICIENT, true);
-
-  // calls 2 NTTs
-  for (uint32_t i = 0; i < 2; i++) ct[i].SetFormat(Format::COEFFICIENT);
-
-  SignedDigitDecompose(params, ct, &dct);
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  uint32_t N = params->GetLWEParams()->GetN();
 
-  for (uint32_t j = 0; j < digitsG2; j++) dct[j].SetFormat(Format::EVALUATION);
+  BlindRotateWorkspace &ws = GetWorkspace(params);
 
   // First obtain both monomial(index) for sk = 1 and monomial(-index) for sk = -1
   auto aNeg = params->GetLWEParams()->Getq().ModSub(a, q);
@@ -390,37 +731,55 @@ void RingGSWAccumulatorScheme::AddToACCGINX(
   // index = m to index = 0
   if (index == m) index = 0;
   if (indexNeg == m) indexNeg = 0;
+  // the accumulator stays in coefficient form, and the products are switched
+  // to it and rotated instead of multiplied by the monomials
+  if (m_ginxRotation && (team == nullptr)) {
+    for (uint32_t i = 0; i < 2; i++) {
+      (*acc)[0][i].SetFormat(Format::COEFFICIENT);
+      ws.ct[i] = (*acc)[0][i];
+    }
+    ExternalProduct(*this, params, input1, &ws, true);
+    for (uint32_t j = 0; j < 2; j++) {
+      ws.prod[j].SetFormat(Format::COEFFICIENT);
+      AddRotation(&(*acc)[0][j], ws.prod[j], index, Q);
+      ws.prod[j].OverrideFormat(Format::EVALUATION);
+    }
+    ExternalProduct(*this, params, input2, &ws, false);
+    for (uint32_t j = 0; j < 2; j++) {
+      ws.prod[j].SetFormat(Format::COEFFICIENT);
+      AddRotation(&(*acc)[0][j], ws.prod[j], indexNeg, Q);
+      ws.prod[j].OverrideFormat(Format::EVALUATION);
+    }
+    return;
+  }
+
   const NativePoly &monomial = params->GetMonomial(index);
   const NativePoly &monomialNeg = params->GetMonomial(indexNeg);
+  for (uint32_t i = 0; i < 2; i++) (*acc)[0][i].SetFormat(Format::EVALUATION);
 
-  // acc = acc + dct * input1 * monomial + dct * input2 * negative_monomial;
-  // uses in-place * operators for the last call to dct[i] to gain performance
-  // improvement. Needs to be done using two loops for ternary secrets.
-  for (uint32_t j = 0; j < 2; j++) {
-    NativePoly temp1 = (j < 1) ? dct[0] * input1[0][j]: (dct[0] * input1[0][j]);
-    for (uint32_t l = 1; l < digitsG2; l++) {
-      if (j == 0)
-        temp1 += dct[l] * input1[l][j];
-      else
-        temp1 += (dct[l] * input1[l][j]);
-    }
-    (*acc)[0][j] += (temp1 * monomial);
-  }
-  for (uint32_t j = 0; j < 2; j++) {
-    NativePoly temp1 = (j < 1) ? dct[0] * input2[0][j]: (dct[0] * input2[0][j]);
-    for (uint32_t l = 1; l < digitsG2; l++) {
-      if (j == 0)
-        temp1 += dct[l] * input2[l][j];
-      else
-        temp1 += (dct[l] * input2[l][j]);
-    }
-    (*acc)[0][j] += (temp1 * monomialNeg);
+  if (team != nullptr) {
+    const RingGSWCiphertext *inputs[2] = {&input1, &input2};
+    const NativePoly *monomials[2] = {&monomial, &monomialNeg};
+    TeamExternalProduct(team, params, inputs, monomials, 2, &ws, acc);
+    return;
   }
+
+  for (uint32_t i = 0; i < 2; i++) ws.ct[i] = (*acc)[0][i];
+
+  // acc = acc + dct * input1 * monomial + dct * input2 * negative_monomial;
+  // the digits are shared by both products
+  ExternalProduct(*this, params, input1, &ws, true);
+  for (uint32_t j = 0; j < 2; j++)
+    MulAcc<true>(&(*acc)[0][j], ws.prod[j], monomial, Q, ws.mu, 0, N);
+  ExternalProduct(*this, params, input2, &ws, false);
+  for (uint32_t j = 0; j < 2; j++)
+    MulAcc<true>(&(*acc)[0][j], ws.prod[j], monomialNeg, Q, ws.mu, 0, N);
 }
 
 std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::BootstrapCore(
-    const std::shared_ptr<RingGSWCryptoParams> params, const BINGATE gate,
-    const RingGSWEvalKey &EK, const NativeVector &a, const NativeInteger &b,
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const NativeInteger &gateConst, const RingGSWEvalKey &EK,
+    const NativeVector &a, const NativeInteger &b,
     const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
   if ((EK.BSkey == nullptr) || (EK.KSkey == nullptr)) {
     std::string errMsg =
@@ -433,13 +792,10 @@ std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::BootstrapCore(
   NativeInteger q = params->GetLWEParams()->Getq();
   NativeInteger Q = params->GetLWEParams()->GetQ();
   uint32_t N = params->GetLWEParams()->GetN();
-  uint32_t baseR = params->GetBaseR();
-  uint32_t n = params->GetLWEParams()->Getn();
-  std::vector<NativeInteger> digitsR = params->GetDigitsR();
 
   // Specifies the range [q1,q2) that will be used for mapping
   uint32_t qHalf = q.ConvertToInt() >> 1;
-  NativeInteger q1 = params->GetGateConst()[static_cast<int>(gate)];
+  NativeInteger q1 = gateConst;
   NativeInteger q2 = q1.ModAddFast(NativeInteger(qHalf), q);
 
   // depending on whether the value is the range, it will be set
@@ -473,25 +829,488 @@ std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::BootstrapCore(
   auto acc = std::make_shared<RingGSWCiphertext>(1, 2);
   (*acc)[0] = std::move(res);
 
+  BlindRotate(params, EK, a, q, acc);
+
+  return acc;
+}
+
+// The threads of the team wait by spinning, so a team larger than the
+// machine would only take turns on the same cores
+void RingGSWAccumulatorScheme::SetBootstrapThreads(uint32_t numThreads) {
+  uint32_t hwThreads = std::thread::hardware_concurrency();
+  if ((hwThreads != 0) && (numThreads > hwThreads)) numThreads = hwThreads;
+
+  std::lock_guard<std::mutex> lock(m_teamMutex);
+  if (numThreads <= 1)
+    m_team.reset();
+  else if ((m_team == nullptr) || (m_team->GetNumThreads() != numThreads))
+    m_team = std::make_shared<SpinTeam>(numThreads);
+}
+
+uint32_t RingGSWAccumulatorScheme::GetBootstrapThreads() const {
+  std::lock_guard<std::mutex> lock(m_teamMutex);
+  return (m_team == nullptr) ? 1 : m_team->GetNumThreads();
+}
+
+// The team is used by one bootstrapping at a time; a bootstrapping that
+// finds it busy, or that is called from a parallel region, runs on the
+// calling thread only
+void RingGSWAccumulatorScheme::BlindRotate(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    const NativeVector &a, const NativeInteger &mod,
+    std::shared_ptr<RingGSWCiphertext> acc) const {
+  uint32_t n = params->GetLWEParams()->Getn();
+
+  std::unique_lock<std::mutex> lock(m_teamMutex, std::try_to_lock);
+  SpinTeam *team = lock.owns_lock() ? m_team.get() : nullptr;
+#ifdef PARALLEL
+  if (omp_in_parallel()) team = nullptr;
+#endif
+  if ((team == nullptr) && lock.owns_lock()) lock.unlock();
+
+  for (uint32_t i = 0; i < n; i++)
+    BlindRotateStep(params, EK, i, mod.ModSub(a[i], mod), mod, acc, team);
+}
+
+void RingGSWAccumulatorScheme::BlindRotateStep(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    uint32_t i, const NativeInteger &aNeg, const NativeInteger &mod,
+    std::shared_ptr<RingGSWCiphertext> acc, SpinTeam *team) const {
   if (params->GetMethod() == AP) {
-    for (uint32_t i = 0; i < n; i++) {
-      NativeInteger aI = q.ModSub(a[i], q);
-      for (uint32_t k = 0; k < digitsR.size();
-           k++, aI /= NativeInteger(baseR)) {
-        uint32_t a0 = (aI.Mod(baseR)).ConvertToInt();
-        if (a0) this->AddToACCAP(params, (*EK.BSkey)[i][a0][k], acc);
-      }
+    uint32_t baseR = params->GetBaseR();
+    uint32_t digitCountR = params->GetDigitsR().size();
+    NativeInteger aI = aNeg;
+    for (uint32_t k = 0; k < digitCountR; k++, aI /= NativeInteger(baseR)) {
+      uint32_t a0 = (aI.Mod(baseR)).ConvertToInt();
+      if (a0) this->AddToACCAP(params, (*EK.BSkey)[i][a0][k], acc, team);
     }
   } else {  // if GINX
-    for (uint32_t i = 0; i < n; i++) {
-      // handles -a*E(1) and handles -a*E(-1) = a*E(1)
-      this->AddToACCGINX(params, (*EK.BSkey)[0][0][i], (*EK.BSkey)[0][1][i], q.ModSub(a[i], q), acc);
+    // handles -a*E(1) and handles -a*E(-1) = a*E(1)
+    this->AddToACCGINX(params, (*EK.BSkey)[0][0][i], (*EK.BSkey)[0][1][i],
+                       aNeg, acc, team);
+  }
+}
+
+std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::SignAccumulator(
+    const std::shared_ptr<RingGSWCryptoParams> params, const NativeInteger &b,
+    const LWEPlaintextModulus p) const {
+  return RotatedAccumulator(params, *GetSignTestVector(params, p), b);
+}
+
+// Test vector of the sign function: the rotation by b - <a,s> brings Q/p to
+// position 0 for phases in [0, N) and -Q/p for phases in [N, 2N)
+std::shared_ptr<const RingGSWTestVector>
+RingGSWAccumulatorScheme::GetSignTestVector(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const LWEPlaintextModulus p) const {
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  uint32_t N = params->GetLWEParams()->GetN();
+  SignTestVectorKey key(p, N, Q.ConvertToInt());
+
+  std::lock_guard<std::mutex> lock(m_testVectorsMutex);
+  auto it = m_signTestVectors.find(key);
+  if (it != m_signTestVectors.end()) return it->second;
+
+  NativeInteger Qp = Q / NativeInteger(p);
+  auto testVector = std::make_shared<RingGSWTestVector>();
+  testVector->coefficients = NativeVector(N, Q);
+  testVector->coefficients[0] = Qp;
+  for (uint32_t j = 1; j < N; j++)
+    testVector->coefficients[j] = Q.ModSub(Qp, Q);
+  testVector->evaluation =
+      NativePoly(params->GetPolyParams(), Format::COEFFICIENT, false);
+  testVector->evaluation.SetValues(testVector->coefficients,
+                                   Format::COEFFICIENT);
+  testVector->evaluation.SetFormat(Format::EVALUATION);
+
+  m_signTestVectors[key] = testVector;
+  return testVector;
+}
+
+// Multiplying by X^b moves coefficient j to j + b; coefficients moved past
+// N - 1 wrap around negated. GINX keeps X^b - 1 in evaluation form for all b
+// in [0, 2N), so X^b * TV = (X^b - 1) * TV + TV is computed pointwise.
+std::shared_ptr<RingGSWCiphertext> RingGSWAccumulatorScheme::RotatedAccumulator(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const RingGSWTestVector &testVector, const NativeInteger &b) const {
+  const shared_ptr<ILNativeParams> polyParams = params->GetPolyParams();
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  uint32_t N = params->GetLWEParams()->GetN();
+  uint32_t shift = b.ConvertToInt() % (2 * N);
+
+  std::vector<NativePoly> res(2);
+  // no need to do NTT as all coefficients of this poly are zero
+  res[0] = NativePoly(polyParams, Format::EVALUATION, true);
+  if (params->GetMethod() == GINX) {
+    res[1] = testVector.evaluation * params->GetMonomial(shift);
+    res[1] += testVector.evaluation;
+  } else {
+    const NativeVector &tv = testVector.coefficients;
+    NativeVector m(N, Q);
+    for (uint32_t j = 0; j < N; ++j) {
+      uint32_t idx = (j + 2 * N - shift) % (2 * N);
+      m[j] = (idx < N) ? tv[idx] : Q.ModSub(tv[idx - N], Q);
     }
+    res[1] = NativePoly(polyParams, Format::COEFFICIENT, false);
+    res[1].SetValues(std::move(m), Format::COEFFICIENT);
+    res[1].SetFormat(Format::EVALUATION);
   }
 
+  auto acc = std::make_shared<RingGSWCiphertext>(1, 2);
+  (*acc)[0] = std::move(res);
   return acc;
 }
 
+std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::SignExtract(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    std::shared_ptr<RingGSWCiphertext> acc,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  return ExtractAndSwitch(params, EK, acc, NativeInteger(0), LWEscheme);
+}
+
+// The accumulator is switched to coefficient form in place. Its first part
+// is encrypted w.r.t. the transposed secret key; transposing a(X) to a(1/X)
+// maps coefficient j to -coefficient N - j, which gives an encryption under
+// the original secret key without another NTT.
+std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::ExtractAndSwitch(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    std::shared_ptr<RingGSWCiphertext> acc, const NativeInteger &bOffset,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  const auto &LWEParams = params->GetLWEParams();
+  NativeInteger Q = LWEParams->GetQ();
+  uint32_t N = LWEParams->GetN();
+
+  StageTimer timer("bootstrap.sample_extraction");
+  NativePoly &a = (*acc)[0][0];
+  NativePoly &b = (*acc)[0][1];
+  a.SetFormat(Format::COEFFICIENT);
+  b.SetFormat(Format::COEFFICIENT);
+
+  for (uint32_t j = 1; j < N / 2; j++) {
+    NativeInteger temp = a[j];
+    a[j] = Q.ModSub(a[N - j], Q);
+    a[N - j] = Q.ModSub(temp, Q);
+  }
+  a[N / 2] = Q.ModSub(a[N / 2], Q);
+
+  // modulus switching to qKS, key switching and modulus switching to q
+  timer.Next("bootstrap.keyswitch");
+  return LWEscheme->ModKeySwitch(LWEParams, EK.KSkey, a.GetValues(),
+                                 bOffset.ModAddFast(b[0], Q));
+}
+
+// Sign evaluation: the input is switched to modulus 2N so that the whole
+// ring is used for the test vector (no sparse embedding is needed)
+std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::EvalSign(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    const std::shared_ptr<const LWECiphertextImpl> ct,
+    const LWEPlaintextModulus p,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  if ((EK.BSkey == nullptr) || (EK.KSkey == nullptr)) {
+    std::string errMsg =
+        "Bootstrapping keys have not been generated. Please call BTKeyGen "
+        "before calling bootstrapping.";
+    PALISADE_THROW(config_error, errMsg);
+  }
+
+  NativeInteger ctMod(2 * params->GetLWEParams()->GetN());
+
+  StageTimer timer("bootstrap.modswitch");
+  auto ctMS = LWEscheme->ModSwitch(ctMod, ct);
+  const NativeVector &a = ctMS->GetA();
+
+  // main accumulation computation
+  // the following loop is the bottleneck of bootstrapping/binary gate
+  // evaluation
+  timer.Next("bootstrap.blind_rotation");
+  auto acc = SignAccumulator(params, ctMS->GetB(), p);
+  BlindRotate(params, EK, a, ctMod, acc);
+  timer.Stop();
+
+  return SignExtract(params, EK, acc, LWEscheme);
+}
+
+// Batched sign evaluation. The ciphertexts are split into one contiguous
+// group per thread. Inside a group the loop over the refreshing key is the
+// outer one, so each key entry is applied to every accumulator of the group
+// while it is still in cache.
+std::vector<std::shared_ptr<LWECiphertextImpl>>
+RingGSWAccumulatorScheme::EvalSignBatch(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    const std::vector<std::shared_ptr<LWECiphertextImpl>> &cts,
+    const LWEPlaintextModulus p,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  if ((EK.BSkey == nullptr) || (EK.KSkey == nullptr)) {
+    std::string errMsg =
+        "Bootstrapping keys have not been generated. Please call BTKeyGen "
+        "before calling bootstrapping.";
+    PALISADE_THROW(config_error, errMsg);
+  }
+
+  uint32_t n = params->GetLWEParams()->Getn();
+  NativeInteger ctMod(2 * params->GetLWEParams()->GetN());
+  uint32_t size = cts.size();
+
+  std::vector<std::shared_ptr<LWECiphertextImpl>> result(size);
+  if (size == 0) return result;
+
+#ifdef PARALLEL
+  // a batch evaluated from inside a parallel region stays on the calling
+  // thread
+  uint32_t groups =
+      omp_in_parallel() ? 1 : std::min<uint32_t>(omp_get_max_threads(), size);
+#else
+  uint32_t groups = 1;
+#endif
+
+#pragma omp parallel for schedule(static, 1)
+  for (uint32_t g = 0; g < groups; g++) {
+    uint32_t begin = g * size / groups;
+    uint32_t end = (g + 1) * size / groups;
+
+    std::vector<std::shared_ptr<LWECiphertextImpl>> ctMS(end - begin);
+    for (uint32_t k = begin; k < end; k++) {
+      StageTimer timer("bootstrap.modswitch");
+      ctMS[k - begin] = LWEscheme->ModSwitch(ctMod, cts[k]);
+    }
+
+    // the blind rotations of the group are interleaved, so each one is
+    // recorded with the average time of the group
+    StageTimer timer("bootstrap.blind_rotation", end - begin);
+    std::vector<std::shared_ptr<RingGSWCiphertext>> acc(end - begin);
+    for (uint32_t k = 0; k < end - begin; k++)
+      acc[k] = SignAccumulator(params, ctMS[k]->GetB(), p);
+
+    for (uint32_t i = 0; i < n; i++)
+      for (uint32_t k = 0; k < end - begin; k++)
+        BlindRotateStep(params, EK, i,
+                        ctMod.ModSub(ctMS[k]->GetA()[i], ctMod), ctMod, acc[k],
+                        nullptr);
+    timer.Stop();
+
+    for (uint32_t k = begin; k < end; k++)
+      result[k] = SignExtract(params, EK, acc[k - begin], LWEscheme);
+  }
+
+  return result;
+}
+
+// Programmable bootstrapping: same as the sign evaluation, with the test
+// vector of the table. The phase is moved up by half a message step so that
+// the rounding window of m is [m*2N/p, (m+1)*2N/p) and the windows of the
+// lower half of Z_p do not cross the negacyclic boundary
+std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::EvalFunc(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    const std::shared_ptr<const LWECiphertextImpl> ct,
+    const std::vector<LWEPlaintext> &LUT, const LWEPlaintextModulus p,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  if ((EK.BSkey == nullptr) || (EK.KSkey == nullptr)) {
+    std::string errMsg =
+        "Bootstrapping keys have not been generated. Please call BTKeyGen "
+        "before calling bootstrapping.";
+    PALISADE_THROW(config_error, errMsg);
+  }
+
+  auto testVector = GetTestVector(params, LUT, p);
+
+  NativeInteger ctMod(2 * params->GetLWEParams()->GetN());
+
+  StageTimer timer("bootstrap.modswitch");
+  auto ctMS = LWEscheme->ModSwitch(ctMod, ct);
+  const NativeVector &a = ctMS->GetA();
+
+  timer.Next("bootstrap.blind_rotation");
+  NativeInteger halfStep(params->GetLWEParams()->GetN() / p);
+  auto acc = RotatedAccumulator(params, *testVector,
+                                ctMS->GetB().ModAdd(halfStep, ctMod));
+  BlindRotate(params, EK, a, ctMod, acc);
+  timer.Stop();
+
+  return SignExtract(params, EK, acc, LWEscheme);
+}
+
+// The phase phi in Z_2N of a message m is in [m*2N/p, (m+1)*2N/p) after the
+// shift of EvalFunc. For phi in [0, N) g(phi) is the table entry of that
+// message scaled to Q/p, and the
+// negacyclic rotation extends it by g(phi + N) = -g(phi). Coefficient j of
+// the test vector for b = 0 is g(-j).
+std::shared_ptr<const RingGSWTestVector>
+RingGSWAccumulatorScheme::GetTestVector(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const std::vector<LWEPlaintext> &LUT, const LWEPlaintextModulus p) const {
+  if (LUT.size() != p)
+    PALISADE_THROW(config_error, "The lookup table must have p entries");
+
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  uint32_t N = params->GetLWEParams()->GetN();
+  if (p > N)
+    PALISADE_THROW(config_error,
+                   "The plaintext modulus must not exceed the ring dimension");
+
+  std::vector<LWEPlaintext> table(p);
+  for (uint32_t m = 0; m < p; m++) {
+    table[m] = LUT[m] % (LWEPlaintext)p;
+    if (table[m] < 0) table[m] += p;
+  }
+  TestVectorKey key(p, N, Q.ConvertToInt(), table);
+
+  std::lock_guard<std::mutex> lock(m_testVectorsMutex);
+  auto it = m_testVectors.find(key);
+  if (it != m_testVectors.end()) return it->second;
+
+  // floor(v*Q/p) without overflowing 64 bits
+  uint64_t QInt = Q.ConvertToInt();
+  auto g = [&](uint64_t phi) {
+    uint64_t v = table[phi * p / (2 * N)];
+    return NativeInteger((QInt / p) * v + (QInt % p) * v / p);
+  };
+
+  auto testVector = std::make_shared<RingGSWTestVector>();
+  testVector->coefficients = NativeVector(N, Q);
+  testVector->coefficients[0] = g(0);
+  for (uint32_t j = 1; j < N; j++)
+    testVector->coefficients[j] = Q.ModSub(g(N - j), Q);
+  testVector->evaluation =
+      NativePoly(params->GetPolyParams(), Format::COEFFICIENT, false);
+  testVector->evaluation.SetValues(testVector->coefficients,
+                                   Format::COEFFICIENT);
+  testVector->evaluation.SetFormat(Format::EVALUATION);
+
+  m_testVectors[key] = testVector;
+  return testVector;
+}
+
+// Multi-value bootstrapping (Carpov, Izabachene and Mollimard, "New
+// techniques for multi-value input homomorphic evaluation and
+// applications"): with TV0 = (Q/2p)(1 + X + ... + X^{N-1}) and
+// (1 + X + ... + X^{N-1})(1 - X) = 1 - X^N = 2, the test vector of a table is
+// TV0 times the factor (1 - X) T, where T is the test vector with the
+// unscaled table entries. The blind rotation of TV0 is shared, and the
+// factor of each table is applied to the rotated accumulator.
+std::vector<std::shared_ptr<LWECiphertextImpl>>
+RingGSWAccumulatorScheme::EvalMultiFunc(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    const std::shared_ptr<const LWECiphertextImpl> ct,
+    const std::vector<std::vector<LWEPlaintext>> &LUTs,
+    const LWEPlaintextModulus p,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  if ((EK.BSkey == nullptr) || (EK.KSkey == nullptr)) {
+    std::string errMsg =
+        "Bootstrapping keys have not been generated. Please call BTKeyGen "
+        "before calling bootstrapping.";
+    PALISADE_THROW(config_error, errMsg);
+  }
+
+  std::vector<std::shared_ptr<const RingGSWTestVector>> factors;
+  for (const auto &LUT : LUTs)
+    factors.push_back(GetTestVectorFactor(params, LUT, p));
+
+  std::vector<std::shared_ptr<LWECiphertextImpl>> result;
+  if (factors.empty()) return result;
+
+  NativeInteger ctMod(2 * params->GetLWEParams()->GetN());
+
+  StageTimer timer("bootstrap.modswitch");
+  auto ctMS = LWEscheme->ModSwitch(ctMod, ct);
+  const NativeVector &a = ctMS->GetA();
+
+  timer.Next("bootstrap.blind_rotation");
+  NativeInteger halfStep(params->GetLWEParams()->GetN() / p);
+  auto acc = RotatedAccumulator(params, *GetMultiFuncTestVector(params, p),
+                                ctMS->GetB().ModAdd(halfStep, ctMod));
+  BlindRotate(params, EK, a, ctMod, acc);
+  for (uint32_t j = 0; j < 2; j++) (*acc)[0][j].SetFormat(Format::EVALUATION);
+  timer.Stop();
+
+  for (const auto &factor : factors) {
+    auto accF = std::make_shared<RingGSWCiphertext>(1, 2);
+    (*accF)[0][0] = (*acc)[0][0] * factor->evaluation;
+    (*accF)[0][1] = (*acc)[0][1] * factor->evaluation;
+    result.push_back(SignExtract(params, EK, accF, LWEscheme));
+  }
+  return result;
+}
+
+// The entries of T are centered in (-p/2, p/2] so that the factor, whose
+// coefficients are the differences of consecutive entries of T, stays small.
+// Coefficient j of T is t(-j) with t(phi) = LUT[phi*p/2N] for phi in [0, N),
+// as in GetTestVector.
+std::shared_ptr<const RingGSWTestVector>
+RingGSWAccumulatorScheme::GetTestVectorFactor(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const std::vector<LWEPlaintext> &LUT, const LWEPlaintextModulus p) const {
+  if (LUT.size() != p)
+    PALISADE_THROW(config_error, "The lookup table must have p entries");
+
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  uint32_t N = params->GetLWEParams()->GetN();
+  if (p > N)
+    PALISADE_THROW(config_error,
+                   "The plaintext modulus must not exceed the ring dimension");
+
+  std::vector<LWEPlaintext> table(p);
+  for (uint32_t m = 0; m < p; m++) {
+    table[m] = LUT[m] % (LWEPlaintext)p;
+    if (table[m] < 0) table[m] += p;
+  }
+  TestVectorKey key(p, N, Q.ConvertToInt(), table);
+
+  std::lock_guard<std::mutex> lock(m_testVectorsMutex);
+  auto it = m_testVectorFactors.find(key);
+  if (it != m_testVectorFactors.end()) return it->second;
+
+  auto t = [&](uint64_t phi) {
+    LWEPlaintext v = table[phi * p / (2 * N)];
+    return (2 * v > (LWEPlaintext)p) ? v - (LWEPlaintext)p : v;
+  };
+  std::vector<LWEPlaintext> T(N);
+  T[0] = t(0);
+  for (uint32_t j = 1; j < N; j++) T[j] = -t(N - j);
+
+  // (1 - X) T, where X T wraps T[N - 1] around to -T[N - 1]
+  auto testVector = std::make_shared<RingGSWTestVector>();
+  testVector->coefficients = NativeVector(N, Q);
+  for (uint32_t j = 0; j < N; j++) {
+    LWEPlaintext c = (j == 0) ? T[0] + T[N - 1] : T[j] - T[j - 1];
+    testVector->coefficients[j] =
+        (c >= 0) ? NativeInteger(c) : Q.ModSub(NativeInteger(-c), Q);
+  }
+  testVector->evaluation =
+      NativePoly(params->GetPolyParams(), Format::COEFFICIENT, false);
+  testVector->evaluation.SetValues(testVector->coefficients,
+                                   Format::COEFFICIENT);
+  testVector->evaluation.SetFormat(Format::EVALUATION);
+
+  m_testVectorFactors[key] = testVector;
+  return testVector;
+}
+
+std::shared_ptr<const RingGSWTestVector>
+RingGSWAccumulatorScheme::GetMultiFuncTestVector(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const LWEPlaintextModulus p) const {
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  uint32_t N = params->GetLWEParams()->GetN();
+  SignTestVectorKey key(p, N, Q.ConvertToInt());
+
+  std::lock_guard<std::mutex> lock(m_testVectorsMutex);
+  auto it = m_multiFuncTestVectors.find(key);
+  if (it != m_multiFuncTestVectors.end()) return it->second;
+
+  auto testVector = std::make_shared<RingGSWTestVector>();
+  testVector->coefficients = NativeVector(N, Q);
+  NativeInteger Q2p = Q / NativeInteger(2 * p);
+  for (uint32_t j = 0; j < N; j++) testVector->coefficients[j] = Q2p;
+  testVector->evaluation =
+      NativePoly(params->GetPolyParams(), Format::COEFFICIENT, false);
+  testVector->evaluation.SetValues(testVector->coefficients,
+                                   Format::COEFFICIENT);
+  testVector->evaluation.SetFormat(Format::EVALUATION);
+
+  m_multiFuncTestVectors[key] = testVector;
+  return testVector;
+}
+
 // Full evaluation as described in "Bootstrapping in FHEW-like
 // Cryptosystems"
 std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::EvalBinGate(
@@ -501,79 +1320,141 @@ std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::EvalBinGate(
     const std::shared_ptr<const LWECiphertextImpl> ct2,
     const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
   NativeInteger q = params->GetLWEParams()->Getq();
-  NativeInteger Q = params->GetLWEParams()->GetQ();
   uint32_t n = params->GetLWEParams()->Getn();
-  uint32_t N = params->GetLWEParams()->GetN();
-  NativeInteger Q8 = Q / NativeInteger(8) + 1;
 
   if (ct1 == ct2) {
     std::string errMsg =
         "ERROR: Please only use independent ciphertexts as inputs.";
     PALISADE_THROW(config_error, errMsg);
   }
+  if ((gate == MAJORITY) || (gate == AND3) || (gate == OR3))
+    PALISADE_THROW(config_error, "This gate takes three inputs");
+
+  NativeVector a(n, q);
+  NativeInteger b;
 
-  // By default, we compute XOR/XNOR using a combination of AND, OR, and NOT
-  // gates
-  if ((gate == XOR) || (gate == XNOR)) {
-    auto ct1NOT = EvalNOT(params, ct1);
-    auto ct2NOT = EvalNOT(params, ct2);
-    auto ctAND1 = EvalBinGate(params, AND, EK, ct1, ct2NOT, LWEscheme);
-    auto ctAND2 = EvalBinGate(params, AND, EK, ct1NOT, ct2, LWEscheme);
-    auto ctOR = EvalBinGate(params, OR, EK, ctAND1, ctAND2, LWEscheme);
-    // NOT is free so there is not cost to do it an extra time for XNOR
-    if (gate == XOR)
-      return ctOR;
-    else  // XNOR
-      return EvalNOT(params, ctOR);
+  // the additive homomorphic operation for XOR/NXOR is different from the
+  // other gates we compute 2*(ct1 - ct2) mod 4 for XOR, me map 1,2 -> 1 and
+  // 3,0 -> 0. The doubled input is either 0 or q/2, so XOR and XNOR map the
+  // ranges of width q/2 centered at these points, which leaves q/4 for the
+  // doubled noise; XOR_FAST and XNOR_FAST keep the ranges of the other gates
+  if ((gate == XOR) || (gate == XNOR) || (gate == XOR_FAST) ||
+      (gate == XNOR_FAST)) {
+    a = ct1->GetA() - ct2->GetA();
+    a += a;
+    b = ct1->GetB().ModSubFast(ct2->GetB(), q);
+    b.ModAddFastEq(b, q);
   } else {
-    NativeVector a(n, q);
-    NativeInteger b;
-
-    // the additive homomorphic operation for XOR/NXOR is different from the
-    // other gates we compute 2*(ct1 - ct2) mod 4 for XOR, me map 1,2 -> 1 and
-    // 3,0 -> 0
-    if ((gate == XOR_FAST) || (gate == XNOR_FAST)) {
-      a = ct1->GetA() - ct2->GetA();
-      a += a;
-      b = ct1->GetB().ModSubFast(ct2->GetB(), q);
-      b.ModAddFastEq(b, q);
-    } else {
-      // for all other gates, we simply compute (ct1 + ct2) mod 4
-      // for AND: 0,1 -> 0 and 2,3 -> 1
-      // for OR: 1,2 -> 1 and 3,0 -> 0
-      a = ct1->GetA() + ct2->GetA();
-      b = ct1->GetB().ModAddFast(ct2->GetB(), q);
-    }
+    // for all other gates, we simply compute (ct1 + ct2) mod 4
+    // for AND: 0,1 -> 0 and 2,3 -> 1
+    // for OR: 1,2 -> 1 and 3,0 -> 0
+    a = ct1->GetA() + ct2->GetA();
+    b = ct1->GetB().ModAddFast(ct2->GetB(), q);
+  }
 
-    auto acc = BootstrapCore(params, gate, EK, a, b, LWEscheme);
+  return GateBootstrap(params, params->GetGateConst()[static_cast<int>(gate)],
+                       EK, a, b, LWEscheme);
+}
 
-    NativeInteger bNew;
-    NativeVector aNew(N, Q);
+// Gates of three inputs: the sum of the inputs is bootstrapped once. With
+// inputs modulo 4 the sums 0,1 map to 0 and 2,3 to 1, which is MAJORITY;
+// AND3 and OR3 need the sums 0..3 on half of the circle, i.e., inputs
+// modulo 6
+std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::EvalBinGate(
+    const std::shared_ptr<RingGSWCryptoParams> params, const BINGATE gate,
+    const RingGSWEvalKey &EK,
+    const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  if (cts.size() == 2) return EvalBinGate(params, gate, EK, cts[0], cts[1],
+                                          LWEscheme);
 
-    // the accumulator result is encrypted w.r.t. the transposed secret key
-    // we can transpose "a" to get an encryption under the original secret key
-    NativePoly temp = (*acc)[0][0];
-    temp = temp.Transpose();
-    temp.SetFormat(Format::COEFFICIENT);
-    aNew = temp.GetValues();
+  if ((gate != MAJORITY) && (gate != AND3) && (gate != OR3))
+    PALISADE_THROW(config_error, "This gate takes two inputs");
+  if (cts.size() != 3)
+    PALISADE_THROW(config_error, "MAJORITY, AND3 and OR3 take three inputs");
 
-    temp = (*acc)[0][1];
-    temp.SetFormat(Format::COEFFICIENT);
-    // we add Q/8 to "b" to to map back to Q/4 (i.e., mod 2) arithmetic.
-    bNew = Q8.ModAddFast(temp[0], Q);
+  NativeVector a;
+  NativeInteger b;
+  SumInputs(params, cts, &a, &b);
+  return GateBootstrap(params, params->GetGateConst()[static_cast<int>(gate)],
+                       EK, a, b, LWEscheme);
+}
 
-    // Modulus switching to a middle step Q'
-    auto eQN = LWEscheme->ModSwitch(params->GetLWEParams()->GetqKS(), std::make_shared<LWECiphertextImpl>(aNew, bNew));
+// The sums 0..k of k inputs modulo p are at multiples of q/p; the range
+// [(t - 1/2)q/p, (t - 1/2)q/p + q/2) has to contain the sums from t to k
+// and none of the others, which leaves q/(2p) on each side for the noise
+std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::EvalThresholdGate(
+    const std::shared_ptr<RingGSWCryptoParams> params, const RingGSWEvalKey &EK,
+    const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts,
+    uint32_t threshold, const LWEPlaintextModulus p,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  uint32_t k = cts.size();
+  if ((k == 0) || (threshold == 0) || (threshold > k))
+    PALISADE_THROW(config_error,
+                   "The threshold must be between 1 and the number of inputs");
+  if ((p < 2) || (p & 1))
+    PALISADE_THROW(config_error, "The plaintext modulus must be even");
+
+  // positions in units of q/(2p), relative to the start of the range
+  int64_t units = 2 * p;
+  for (uint32_t sum = 0; sum <= k; sum++) {
+    int64_t pos = (2 * (int64_t)sum - (2 * (int64_t)threshold - 1)) % units;
+    if (pos < 0) pos += units;
+    if ((pos < (int64_t)p) != (sum >= threshold))
+      PALISADE_THROW(config_error,
+                     "The plaintext modulus is too small for this threshold "
+                     "and number of inputs");
+  }
 
-    // Key switching
-    const std::shared_ptr<const LWECiphertextImpl> eQ =
-        LWEscheme->KeySwitch(params->GetLWEParams(), EK.KSkey, eQN);
+  NativeInteger q = params->GetLWEParams()->Getq();
+  // start of the range mapped to 0
+  NativeInteger gateConst((2 * threshold - 1 + p) * q.ConvertToInt() /
+                          (2 * p));
+  gateConst.ModEq(q);
+
+  NativeVector a;
+  NativeInteger b;
+  SumInputs(params, cts, &a, &b);
+  return GateBootstrap(params, gateConst, EK, a, b, LWEscheme);
+}
 
-    // Modulus switching
-    return LWEscheme->ModSwitch(q, eQ);
+void RingGSWAccumulatorScheme::SumInputs(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const std::vector<std::shared_ptr<const LWECiphertextImpl>> &cts,
+    NativeVector *a, NativeInteger *b) const {
+  NativeInteger q = params->GetLWEParams()->Getq();
+  for (uint32_t i = 0; i < cts.size(); i++)
+    for (uint32_t j = 0; j < i; j++)
+      if (cts[i] == cts[j]) {
+        std::string errMsg =
+            "ERROR: Please only use independent ciphertexts as inputs.";
+        PALISADE_THROW(config_error, errMsg);
+      }
+
+  *a = cts[0]->GetA();
+  *b = cts[0]->GetB();
+  for (uint32_t i = 1; i < cts.size(); i++) {
+    *a += cts[i]->GetA();
+    b->ModAddFastEq(cts[i]->GetB(), q);
   }
 }
 
+// Bootstraps the combined input of a gate and switches the result back to
+// (q,n)
+std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::GateBootstrap(
+    const std::shared_ptr<RingGSWCryptoParams> params,
+    const NativeInteger &gateConst, const RingGSWEvalKey &EK,
+    const NativeVector &a, const NativeInteger &b,
+    const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  NativeInteger Q8 = Q / NativeInteger(8) + 1;
+
+  auto acc = BootstrapCore(params, gateConst, EK, a, b, LWEscheme);
+
+  // we add Q/8 to "b" to to map back to Q/4 (i.e., mod 2) arithmetic.
+  return ExtractAndSwitch(params, EK, acc, Q8, LWEscheme);
+}
+
 // Full evaluation as described in "Bootstrapping in FHEW-like
 // Cryptosystems"
 std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::Bootstrap(
@@ -581,10 +1462,7 @@ std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::Bootstrap(
     const std::shared_ptr<const LWECiphertextImpl> ct1,
     const std::shared_ptr<LWEEncryptionScheme> LWEscheme) const {
   NativeInteger q = params->GetLWEParams()->Getq();
-  NativeInteger Q = params->GetLWEParams()->GetQ();
   uint32_t n = params->GetLWEParams()->Getn();
-  uint32_t N = params->GetLWEParams()->GetN();
-  NativeInteger Q8 = Q / NativeInteger(8) + 1;
 
   NativeVector a(n, q);
   NativeInteger b;
@@ -592,32 +1470,8 @@ std::shared_ptr<LWECiphertextImpl> RingGSWAccumulatorScheme::Bootstrap(
   a = ct1->GetA();
   b = ct1->GetB().ModAddFast(q >> 2, q);
 
-  auto acc = BootstrapCore(params, AND, EK, a, b, LWEscheme);
-
-  NativeInteger bNew;
-  NativeVector aNew(N, Q);
-
-  // the accumulator result is encrypted w.r.t. the transposed secret key
-  // we can transpose "a" to get an encryption under the original secret key
-  NativePoly temp = (*acc)[0][0];
-  temp = temp.Transpose();
-  temp.SetFormat(Format::COEFFICIENT);
-  aNew = temp.GetValues();
-
-  temp = (*acc)[0][1];
-  temp.SetFormat(Format::COEFFICIENT);
-  // we add Q/8 to "b" to to map back to Q/4 (i.e., mod 2) arithmetic.
-  bNew = Q8.ModAddFast(temp[0], Q);
-
-  // Modulus switching to a middle step Q'
-  auto eQN = LWEscheme->ModSwitch(params->GetLWEParams()->GetqKS(), std::make_shared<LWECiphertextImpl>(aNew, bNew));
-
-  // Key switching
-  const std::shared_ptr<const LWECiphertextImpl> eQ =
-      LWEscheme->KeySwitch(params->GetLWEParams(), EK.KSkey, eQN);
-
-  // Modulus switching
-  return LWEscheme->ModSwitch(q, eQ);
+  return GateBootstrap(params, params->GetGateConst()[static_cast<int>(AND)],
+                       EK, a, b, LWEscheme);
 }
 
 // Evaluation of the NOT operation; no key material is needed
@@ -0,0 +1,175 @@
+// @file keystream.cpp - Implementation file for the binary streams of
+// refreshing keys
+//
+// @author TPOC: contact@palisade-crypto.org
+// @copyright Copyright (c) 2019, Duality Technologies Inc.
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "keystream.h"
+
+#include <string>
+#include <utility>
+
+namespace lbcrypto {
+
+// "BTKY" and the version of the format
+static const uint32_t BTKEY_MAGIC = 0x594b5442;
+static const uint32_t BTKEY_VERSION = 1;
+
+// header: magic, version, dim1, dim2, dim3, N, then Q
+static const uint32_t BTKEY_HEADER_WORDS = 6;
+
+// FNV-1a over 64-bit words
+static const uint64_t CHECKSUM_BASIS = 0xcbf29ce484222325ULL;
+static const uint64_t CHECKSUM_PRIME = 0x100000001b3ULL;
+
+static inline uint64_t Checksum(uint64_t h, const uint64_t *words,
+                                size_t count) {
+  for (size_t k = 0; k < count; k++) h = (h ^ words[k]) * CHECKSUM_PRIME;
+  return h;
+}
+
+RingGSWBTKeyWriter::RingGSWBTKeyWriter(
+    std::ostream &os, const std::shared_ptr<RingGSWCryptoParams> params,
+    uint32_t dim1, uint32_t dim2, uint32_t dim3)
+    : m_os(os),
+      m_N(params->GetLWEParams()->GetN()),
+      m_entries((uint64_t)dim1 * dim2 * dim3),
+      m_checksum(CHECKSUM_BASIS),
+      m_buffer(m_N) {
+  uint32_t header[BTKEY_HEADER_WORDS] = {BTKEY_MAGIC, BTKEY_VERSION, dim1,
+                                         dim2,        dim3,          m_N};
+  uint64_t Q = params->GetLWEParams()->GetQ().ConvertToInt();
+  m_os.write(reinterpret_cast<const char *>(header), sizeof(header));
+  m_os.write(reinterpret_cast<const char *>(&Q), sizeof(Q));
+  if (!m_os)
+    PALISADE_THROW(serialize_error, "Cannot write the refreshing key header");
+}
+
+void RingGSWBTKeyWriter::WriteWords(const uint64_t *words, size_t count) {
+  m_checksum = Checksum(m_checksum, words, count);
+  m_os.write(reinterpret_cast<const char *>(words), count * sizeof(uint64_t));
+  if (!m_os)
+    PALISADE_THROW(serialize_error, "Cannot write a refreshing key entry");
+}
+
+void RingGSWBTKeyWriter::Write(const RingGSWCiphertext &entry) {
+  if (m_written == m_entries)
+    PALISADE_THROW(serialize_error, "All refreshing key entries are written");
+
+  const auto &elements = entry.GetElements();
+  uint64_t rows = elements.size();
+  WriteWords(&rows, 1);
+  for (const auto &row : elements) {
+    if (row.size() != 2)
+      PALISADE_THROW(serialize_error, "A key entry row must have 2 elements");
+    for (const auto &poly : row) {
+      if (poly.GetFormat() != Format::EVALUATION || poly.GetLength() != m_N)
+        PALISADE_THROW(serialize_error,
+                       "Key entries must be in evaluation form in the ring");
+      for (uint32_t k = 0; k < m_N; k++)
+        m_buffer[k] = poly[k].ConvertToInt();
+      WriteWords(m_buffer.data(), m_N);
+    }
+  }
+  m_written++;
+}
+
+void RingGSWBTKeyWriter::Close() {
+  if (m_written != m_entries)
+    PALISADE_THROW(serialize_error,
+                   "Only " + std::to_string(m_written) + " of " +
+                       std::to_string(m_entries) +
+                       " refreshing key entries are written");
+  m_os.write(reinterpret_cast<const char *>(&m_checksum), sizeof(m_checksum));
+  m_os.flush();
+  if (!m_os)
+    PALISADE_THROW(serialize_error, "Cannot write the refreshing key");
+}
+
+std::shared_ptr<RingGSWBTKey> ReadRingGSWBTKey(
+    std::istream &is, const std::shared_ptr<RingGSWCryptoParams> params) {
+  uint32_t header[BTKEY_HEADER_WORDS];
+  uint64_t Q;
+  is.read(reinterpret_cast<char *>(header), sizeof(header));
+  is.read(reinterpret_cast<char *>(&Q), sizeof(Q));
+  if (!is || header[0] != BTKEY_MAGIC)
+    PALISADE_THROW(deserialize_error, "The stream is not a refreshing key");
+  if (header[1] > BTKEY_VERSION)
+    PALISADE_THROW(deserialize_error,
+                   "serialized object version " + std::to_string(header[1]) +
+                       " is from a later version of the library");
+
+  NativeInteger modulus = params->GetLWEParams()->GetQ();
+  uint32_t N = params->GetLWEParams()->GetN();
+  if (header[5] != N || Q != modulus.ConvertToInt())
+    PALISADE_THROW(deserialize_error,
+                   "The refreshing key is for another ring dimension or "
+                   "modulus");
+
+  uint32_t dim1 = header[2], dim2 = header[3], dim3 = header[4];
+  auto key = std::make_shared<RingGSWBTKey>(dim1, dim2, dim3);
+  const auto &polyParams = params->GetPolyParams();
+  uint32_t digitsG2 = params->GetDigitsG2();
+  uint64_t checksum = CHECKSUM_BASIS;
+  std::vector<uint64_t> buffer(N);
+
+  auto read = [&](uint64_t *words, size_t count) {
+    is.read(reinterpret_cast<char *>(words), count * sizeof(uint64_t));
+    if (!is)
+      PALISADE_THROW(deserialize_error, "The refreshing key is truncated");
+    checksum = Checksum(checksum, words, count);
+  };
+
+  for (uint32_t i = 0; i < dim1; i++) {
+    for (uint32_t j = 0; j < dim2; j++) {
+      for (uint32_t k = 0; k < dim3; k++) {
+        uint64_t rows;
+        read(&rows, 1);
+        if (rows == 0) continue;
+        if (rows != digitsG2)
+          PALISADE_THROW(deserialize_error,
+                         "A refreshing key entry has the wrong size");
+
+        RingGSWCiphertext &entry = (*key)[i][j][k];
+        entry = RingGSWCiphertext(digitsG2, 2);
+        for (uint32_t r = 0; r < digitsG2; r++) {
+          for (uint32_t c = 0; c < 2; c++) {
+            read(buffer.data(), N);
+            NativeVector values(N, modulus);
+            for (uint32_t l = 0; l < N; l++) values[l] = buffer[l];
+            entry[r][c] = NativePoly(polyParams, Format::EVALUATION, false);
+            entry[r][c].SetValues(std::move(values), Format::EVALUATION);
+          }
+        }
+        entry.PrecomputeShoup();
+      }
+    }
+  }
+
+  uint64_t expected;
+  is.read(reinterpret_cast<char *>(&expected), sizeof(expected));
+  if (!is || expected != checksum)
+    PALISADE_THROW(deserialize_error,
+                   "The checksum of the refreshing key does not match");
+  return key;
+}
+
+}  // namespace lbcrypto
@@ -28,9 +28,20 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "lwe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #include "math/binaryuniformgenerator.h"
 #include "math/discreteuniformgenerator.h"
 #include "math/ternaryuniformgenerator.h"
+#include "utils/alignedallocator.h"
+#include "utils/parallel.h"
 
 namespace lbcrypto {
 
@@ -120,14 +131,76 @@ void LWEEncryptionScheme::Decrypt(
   return;
 }
 
-// the main rounding operation used in ModSwitch (as described in Section 3 of
-// https://eprint.iacr.org/2014/816) The idea is that Round(x) = 0.5 + Floor(x)
-NativeInteger RoundqQ(const NativeInteger &v, const NativeInteger &q,
-                      const NativeInteger &Q) {
-  return NativeInteger((uint64_t)std::floor(0.5 + v.ConvertToDouble() *
-                                                      q.ConvertToDouble() /
-                                                      Q.ConvertToDouble()))
-      .Mod(q);
+// Constants of the main rounding operation used in ModSwitch (as described
+// in Section 3 of https://eprint.iacr.org/2014/816), v -> Round(v * q / Q),
+// computed once per switch so that the coefficients need no division. If q
+// and Q are powers of two the rounding is a shift; otherwise the rounding
+// uses the fixed-point ratio floor(2^64 * q / Q) (see RoundqQ)
+typedef struct {
+  NativeInteger::Integer q;
+  NativeInteger::Integer Q;
+  bool pow2;
+  // Round(v * q / Q) = ((v + half) >> down) << up, modulo q, for powers of
+  // two
+  NativeInteger::Integer half;
+  uint32_t down;
+  uint32_t up;
+#if defined(HAVE_INT128)
+  DoubleNativeInt ratio;
+#endif
+} RoundqQConsts;
+
+static RoundqQConsts GetRoundqQConsts(const NativeInteger &q,
+                                      const NativeInteger &Q) {
+  RoundqQConsts c;
+  c.q = q.ConvertToInt();
+  c.Q = Q.ConvertToInt();
+  c.pow2 = ((c.q & (c.q - 1)) == 0) && ((c.Q & (c.Q - 1)) == 0);
+  uint32_t logq = q.GetMSB() - 1;
+  uint32_t logQ = Q.GetMSB() - 1;
+  c.down = (logQ > logq) ? logQ - logq : 0;
+  c.up = (logq > logQ) ? logq - logQ : 0;
+  c.half = (c.down > 0) ? NativeInteger::Integer(1) << (c.down - 1) : 0;
+#if defined(HAVE_INT128)
+  c.ratio = (DoubleNativeInt(c.q) << 64) / c.Q;
+#endif
+  return c;
+}
+
+// The product v * ratio / 2^64 is below v * q / Q by less than v / 2^64 < 1,
+// so the rounded product is Round(v * q / Q) or one less; comparing
+// (r + 1) * 2Q with 2vq + Q tells which one.
+static inline NativeInteger::Integer RoundqQ(NativeInteger::Integer v,
+                                             const RoundqQConsts &c) {
+  typedef NativeInteger::Integer Word;
+  if (c.pow2) return (((v + c.half) >> c.down) << c.up) & (c.q - 1);
+#if defined(HAVE_INT128)
+  Word r = (v * c.ratio + (DoubleNativeInt(1) << 63)) >> 64;
+  DoubleNativeInt x = 2 * DoubleNativeInt(v) * c.q + c.Q;
+  if (DoubleNativeInt(r + 1) * (2 * DoubleNativeInt(c.Q)) <= x) r++;
+  return (r >= c.q) ? r - c.q : r;
+#else
+  Word r = std::floor(0.5 + static_cast<double>(v) * static_cast<double>(c.q) /
+                                static_cast<double>(c.Q));
+  return r % c.q;
+#endif
+}
+
+// Rounds n coefficients; in may be the same buffer as out. The shifts of the
+// powers of two are kept in a loop of their own, which the compiler
+// vectorizes
+static void RoundqQ(const NativeInteger *in, NativeInteger *out, uint32_t n,
+                    const RoundqQConsts &c) {
+  typedef NativeInteger::Integer Word;
+  const Word *x = reinterpret_cast<const Word *>(in);
+  Word *y = reinterpret_cast<Word *>(out);
+  if (c.pow2) {
+    Word mask = c.q - 1;
+    for (uint32_t k = 0; k < n; ++k)
+      y[k] = (((x[k] + c.half) >> c.down) << c.up) & mask;
+  } else {
+    for (uint32_t k = 0; k < n; ++k) y[k] = RoundqQ(x[k], c);
+  }
 }
 
 // Modulus switching - directly applies the scale-and-round operation RoundQ
@@ -135,19 +208,21 @@ std::shared_ptr<LWECiphertextImpl> LWEEncryptionScheme::ModSwitch(
     NativeInteger q, const std::shared_ptr<const LWECiphertextImpl> ctQ) const {
   auto n = ctQ->GetA().GetLength();
   auto Q = ctQ->GetA().GetModulus();
+  RoundqQConsts c = GetRoundqQConsts(q, Q);
 
   NativeVector a(n, q);
-  for (uint32_t i = 0; i < n; ++i) a[i] = RoundqQ(ctQ->GetA()[i], q, Q);
-  NativeInteger b = RoundqQ(ctQ->GetB(), q, Q);
+  if (n > 0) RoundqQ(&ctQ->GetA()[0], &a[0], n, c);
+  NativeInteger b = RoundqQ(ctQ->GetB().ConvertToInt(), c);
 
-  return std::make_shared<LWECiphertextImpl>(LWECiphertextImpl(a, b));
+  return std::make_shared<LWECiphertextImpl>(std::move(a), b);
 }
 
 // Switching key as described in Section 3 of https://eprint.iacr.org/2014/816
 std::shared_ptr<LWESwitchingKey> LWEEncryptionScheme::KeySwitchGen(
     const std::shared_ptr<LWECryptoParams> params,
     const std::shared_ptr<const LWEPrivateKeyImpl> sk,
-    const std::shared_ptr<const LWEPrivateKeyImpl> skN) const {
+    const std::shared_ptr<const LWEPrivateKeyImpl> skN,
+    uint32_t numThreads) const {
   // Create local copies of main variables
   uint32_t n = params->Getn();
   uint32_t N = params->GetN();
@@ -177,13 +252,14 @@ std::shared_ptr<LWESwitchingKey> LWEEncryptionScheme::KeySwitchGen(
 
   NativeInteger mu = Q.ComputeMu();
 
-  std::vector<std::vector<std::vector<LWECiphertextImpl>>> resultVec(N);
+  auto result = std::make_shared<LWESwitchingKey>(N, baseKS, expKS, n, Q);
 
-#pragma omp parallel for
+#ifdef PARALLEL
+  if (numThreads == 0) numThreads = omp_get_max_threads();
+#endif
+#pragma omp parallel for num_threads(numThreads)
   for (uint32_t i = 0; i < N; ++i) {
-    std::vector<std::vector<LWECiphertextImpl>> vector1(baseKS);
     for (uint32_t j = 0; j < baseKS; ++j) {
-      std::vector<LWECiphertextImpl> vector2(expKS);
       for (uint32_t k = 0; k < expKS; ++k) {
         NativeInteger b = (params->GetDgg().GenerateInteger(Q))
                               .ModAdd(oldSK[i].ModMul(j * digitsKS[k], Q), Q);
@@ -201,14 +277,97 @@ std::shared_ptr<LWESwitchingKey> LWEEncryptionScheme::KeySwitchGen(
         b.ModEq(Q);
 #endif
 
-        vector2[k] = LWECiphertextImpl(a, b);
+        result->SetRow(i, j, k, LWECiphertextImpl(std::move(a), b));
+      }
+    }
+  }
+
+  return result;
+}
+
+// acc[k] += row[k] for k < n; n is a multiple of the vector width and both
+// buffers are 64-byte aligned
+static inline void AddRow(uint64_t *acc, const uint64_t *row, uint32_t n) {
+  uint32_t k = 0;
+#if defined(__AVX512F__)
+  for (; k + 8 <= n; k += 8) {
+    __m512i v = _mm512_load_si512(reinterpret_cast<const void *>(row + k));
+    __m512i s = _mm512_load_si512(reinterpret_cast<const void *>(acc + k));
+    _mm512_store_si512(reinterpret_cast<void *>(acc + k),
+                       _mm512_add_epi64(s, v));
+  }
+#elif defined(__AVX2__)
+  for (; k + 4 <= n; k += 4) {
+    __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i *>(row + k));
+    __m256i s = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + k));
+    _mm256_store_si256(reinterpret_cast<__m256i *>(acc + k),
+                       _mm256_add_epi64(s, v));
+  }
+#endif
+  for (; k < n; k++) acc[k] += row[k];
+}
+
+// the same for the rows of a compact key, which are widened to 64 bits
+static inline void AddRow(uint64_t *acc, const uint32_t *row, uint32_t n) {
+  uint32_t k = 0;
+#if defined(__AVX512F__)
+  for (; k + 8 <= n; k += 8) {
+    __m512i v = _mm512_cvtepu32_epi64(
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(row + k)));
+    __m512i s = _mm512_load_si512(reinterpret_cast<const void *>(acc + k));
+    _mm512_store_si512(reinterpret_cast<void *>(acc + k),
+                       _mm512_add_epi64(s, v));
+  }
+#elif defined(__AVX2__)
+  for (; k + 4 <= n; k += 4) {
+    __m256i v = _mm256_cvtepu32_epi64(
+        _mm_load_si128(reinterpret_cast<const __m128i *>(row + k)));
+    __m256i s = _mm256_load_si256(reinterpret_cast<const __m256i *>(acc + k));
+    _mm256_store_si256(reinterpret_cast<__m256i *>(acc + k),
+                       _mm256_add_epi64(s, v));
+  }
+#endif
+  for (; k < n; k++) acc[k] += row[k];
+}
+
+template <typename Word>
+static inline void AddRow(uint64_t *acc, const Word *row, uint32_t n) {
+  for (uint32_t k = 0; k < n; k++) acc[k] += row[k];
+}
+
+// Sums the rows of the switching key selected by the digits of the N
+// coefficients coefficient(i), which are modulo qKS. The rows hold both a and
+// b, and are summed without reduction in 64-bit lanes; the sums are only
+// reduced when another row could overflow them. The rows of a compact key
+// are widened as they are added. The result is in acc, in [0, qKS), with
+// the stride of the key.
+template <typename F>
+static void SumKeyRows(const LWESwitchingKey &K, uint32_t N, uint32_t baseKS,
+                       uint32_t expKS, uint64_t qKS, F coefficient,
+                       AlignedVector<uint64_t> *accVec) {
+  uint32_t stride = K.GetStride();
+  accVec->assign(stride, 0);
+  uint64_t *acc = accVec->data();
+
+  // number of rows, each below qKS, that fit in 64 bits
+  const uint64_t maxRows = std::numeric_limits<uint64_t>::max() / qKS;
+  uint64_t rows = 0;
+
+  for (uint32_t i = 0; i < N; ++i) {
+    uint64_t atmp = coefficient(i);
+    for (uint32_t j = 0; j < expKS; ++j, atmp /= baseKS) {
+      if (++rows == maxRows) {
+        for (uint32_t k = 0; k < stride; k++) acc[k] %= qKS;
+        rows = 1;
       }
-      vector1[j] = std::move(vector2);
+      if (K.IsCompact())
+        AddRow(acc, K.GetCompactRow(i, atmp % baseKS, j), stride);
+      else
+        AddRow(acc, K.GetRow(i, atmp % baseKS, j), stride);
     }
-    resultVec[i] = std::move(vector1);
   }
 
-  return std::make_shared<LWESwitchingKey>(LWESwitchingKey(resultVec));
+  for (uint32_t k = 0; k < stride; k++) acc[k] %= qKS;
 }
 
 // the key switching operation as described in Section 3 of
@@ -221,25 +380,52 @@ std::shared_ptr<LWECiphertextImpl> LWEEncryptionScheme::KeySwitch(
   uint32_t N = params->GetN();
   NativeInteger Q = params->GetqKS();
   uint32_t baseKS = params->GetBaseKS();
-  std::vector<NativeInteger> digitsKS = params->GetDigitsKS();
-  uint32_t expKS = digitsKS.size();
+  uint32_t expKS = params->GetDigitsKS().size();
+  uint64_t qKS = Q.ConvertToInt();
+
+  thread_local AlignedVector<uint64_t> acc;
+  const NativeVector &aOld = ctQN->GetA();
+  SumKeyRows(*K, N, baseKS, expKS, qKS,
+             [&](uint32_t i) { return aOld[i].ConvertToInt(); }, &acc);
 
-  // creates an empty vector
   NativeVector a(n, Q);
-  NativeInteger b = ctQN->GetB();
-  NativeVector aOld = ctQN->GetA();
+  for (uint32_t k = 0; k < n; ++k) a[k] = (acc[k] == 0) ? 0 : qKS - acc[k];
+  NativeInteger b = ctQN->GetB().ModSubFast(acc[n], Q);
 
-  for (uint32_t i = 0; i < N; ++i) {
-    NativeInteger atmp = aOld[i];
-    for (uint32_t j = 0; j < expKS; ++j, atmp /= baseKS) {
-      uint64_t a0 = (atmp % baseKS).ConvertToInt();
-      for (uint32_t k = 0; k < n; ++k)
-        a[k].ModSubFastEq((K->GetElements()[i][a0][j]).GetA()[k], Q);
-      b.ModSubFastEq((K->GetElements()[i][a0][j]).GetB(), Q);
-    }
-  }
+  return std::make_shared<LWECiphertextImpl>(std::move(a), b);
+}
 
-  return std::make_shared<LWECiphertextImpl>(LWECiphertextImpl(a, b));
+// The coefficients are switched to qKS one at a time as their digits are
+// needed. The key-switched vector is switched to q in place.
+std::shared_ptr<LWECiphertextImpl> LWEEncryptionScheme::ModKeySwitch(
+    const std::shared_ptr<LWECryptoParams> params,
+    const std::shared_ptr<LWESwitchingKey> K, const NativeVector &aN,
+    const NativeInteger &bN) const {
+  uint32_t n = params->Getn();
+  uint32_t N = params->GetN();
+  NativeInteger q = params->Getq();
+  NativeInteger Q = params->GetQ();
+  NativeInteger qKS = params->GetqKS();
+  uint32_t baseKS = params->GetBaseKS();
+  uint32_t expKS = params->GetDigitsKS().size();
+  uint64_t qKSInt = qKS.ConvertToInt();
+
+  RoundqQConsts toKS = GetRoundqQConsts(qKS, Q);
+  RoundqQConsts toq = GetRoundqQConsts(q, qKS);
+
+  thread_local AlignedVector<uint64_t> acc;
+  SumKeyRows(*K, N, baseKS, expKS, qKSInt,
+             [&](uint32_t i) { return RoundqQ(aN[i].ConvertToInt(), toKS); },
+             &acc);
+
+  NativeVector a(n, q);
+  for (uint32_t k = 0; k < n; ++k) a[k] = (acc[k] == 0) ? 0 : qKSInt - acc[k];
+  RoundqQ(&a[0], &a[0], n, toq);
+  NativeInteger b = NativeInteger(RoundqQ(bN.ConvertToInt(), toKS))
+                        .ModSubFast(acc[n], qKS);
+  b = RoundqQ(b.ConvertToInt(), toq);
+
+  return std::make_shared<LWECiphertextImpl>(std::move(a), b);
 }
 
 // noiseless LWE embedding
@@ -258,4 +444,116 @@ std::shared_ptr<LWECiphertextImpl> LWEEncryptionScheme::NoiselessEmbedding(
 
   return std::make_shared<LWECiphertextImpl>(LWECiphertextImpl(a, b));
 }
+
+// acc[k] += a[k] * w for k < n; a[k] and w are below 2^32, so each product
+// fits in 64 bits and the unsigned 32x32->64 multiply can be used
+static inline void MulAddLazy(uint64_t *acc, const uint64_t *a, uint64_t w,
+                              uint32_t n) {
+  uint32_t k = 0;
+#if defined(__AVX512F__)
+  const __m512i vw = _mm512_set1_epi64(w);
+  for (; k + 8 <= n; k += 8) {
+    __m512i va = _mm512_loadu_si512(reinterpret_cast<const void *>(a + k));
+    __m512i vacc = _mm512_loadu_si512(reinterpret_cast<const void *>(acc + k));
+    vacc = _mm512_add_epi64(vacc, _mm512_mul_epu32(va, vw));
+    _mm512_storeu_si512(reinterpret_cast<void *>(acc + k), vacc);
+  }
+#elif defined(__AVX2__)
+  const __m256i vw = _mm256_set1_epi64x(w);
+  for (; k + 4 <= n; k += 4) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + k));
+    __m256i vacc =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc + k));
+    vacc = _mm256_add_epi64(vacc, _mm256_mul_epu32(va, vw));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + k), vacc);
+  }
+#endif
+  for (; k < n; k++) acc[k] += a[k] * w;
+}
+
+// Weights are used in centered form: a weight w > q/2 is accumulated as
+// q - w into a separate "negative" accumulator. DiNN weights are small, so
+// both accumulators take many products before they need a reduction.
+void LWEEncryptionScheme::EvalLWELinear(
+    const NativeVector &W,
+    const std::vector<std::shared_ptr<LWECiphertextImpl>> &inputs,
+    const std::vector<LWECiphertextImpl> &biases,
+    std::vector<std::shared_ptr<LWECiphertextImpl>> *outputs) const {
+  uint32_t numIn = inputs.size();
+  uint32_t numOut = biases.size();
+  if (W.GetLength() != (size_t)numIn * numOut)
+    PALISADE_THROW(config_error,
+                   "The weight matrix does not match the inputs and biases");
+
+  outputs->resize(numOut);
+  for (uint32_t j = 0; j < numOut; j++) {
+    if ((*outputs)[j] == nullptr)
+      (*outputs)[j] = std::make_shared<LWECiphertextImpl>(biases[j]);
+    else
+      *(*outputs)[j] = biases[j];
+  }
+  if ((numIn == 0) || (numOut == 0)) return;
+
+  const NativeInteger &q = biases[0].GetA().GetModulus();
+  uint32_t n = biases[0].GetA().GetLength();
+
+  if (q.GetMSB() > 32) {
+    for (uint32_t j = 0; j < numOut; j++)
+      for (uint32_t i = 0; i < numIn; i++)
+        (*outputs)[j]->AddScaledEq(*inputs[i], W[(size_t)j * numIn + i]);
+    return;
+  }
+
+  uint64_t qInt = q.ConvertToInt();
+  uint64_t qHalf = qInt >> 1;
+  const uint64_t maxAcc = std::numeric_limits<uint64_t>::max();
+
+  // the inputs as one block of n+1 words each, b last
+  uint32_t stride = n + 1;
+  std::vector<uint64_t> in((size_t)numIn * stride);
+  for (uint32_t i = 0; i < numIn; i++) {
+    const NativeVector &a = inputs[i]->GetA();
+    uint64_t *row = &in[(size_t)i * stride];
+    for (uint32_t k = 0; k < n; k++) row[k] = a[k].ConvertToInt();
+    row[n] = inputs[i]->GetB().ConvertToInt();
+  }
+
+  std::vector<uint64_t> accPos(stride);
+  std::vector<uint64_t> accNeg(stride);
+  for (uint32_t j = 0; j < numOut; j++) {
+    std::fill(accPos.begin(), accPos.end(), 0);
+    std::fill(accNeg.begin(), accNeg.end(), 0);
+    // upper bounds of the accumulated values
+    uint64_t boundPos = 0;
+    uint64_t boundNeg = 0;
+
+    for (uint32_t i = 0; i < numIn; i++) {
+      uint64_t w = W[(size_t)j * numIn + i].ConvertToInt();
+      if (w == 0) continue;
+      bool neg = w > qHalf;
+      if (neg) w = qInt - w;
+
+      std::vector<uint64_t> &acc = neg ? accNeg : accPos;
+      uint64_t &bound = neg ? boundNeg : boundPos;
+      uint64_t inc = (qInt - 1) * w;
+      if (inc > maxAcc - bound) {
+        for (auto &v : acc) v %= qInt;
+        bound = qInt - 1;
+      }
+      bound += inc;
+      MulAddLazy(acc.data(), &in[(size_t)i * stride], w, stride);
+    }
+
+    NativeVector &a = (*outputs)[j]->GetA();
+    for (uint32_t k = 0; k < n; k++) {
+      uint64_t v = a[k].ConvertToInt() + accPos[k] % qInt;
+      v += qInt - accNeg[k] % qInt;
+      a[k] = v % qInt;
+    }
+    uint64_t b = (*outputs)[j]->GetB().ConvertToInt() + accPos[n] % qInt;
+    b += qInt - accNeg[n] % qInt;
+    (*outputs)[j]->SetB(NativeInteger(b % qInt));
+  }
+}
+
 };  // namespace lbcrypto
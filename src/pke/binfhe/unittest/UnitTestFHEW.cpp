@@ -23,6 +23,7 @@
 // SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "binfhecontext.h"
+#include "math/discreteuniformgenerator.h"
 #include "gtest/gtest.h"
 
 using namespace lbcrypto;
@@ -134,6 +135,122 @@ TEST(UnitTestFHEWAP, ModSwitch) {
   EXPECT_EQ(0, resultAfterModSwitch0) << "Failed mod switching test";
 }
 
+// Checks that the fused switch from (Q,N) to (q,n) matches modulus
+// switching, key switching and modulus switching done one after another
+TEST(UnitTestFHEWAP, ModKeySwitch) {
+  auto cc = BinFHEContext();
+
+  cc.GenerateBinFHEContext(TOY, AP);
+
+  auto LWEParams = cc.GetParams()->GetLWEParams();
+  auto sk = cc.KeyGen();
+  auto skN = cc.KeyGenN();
+
+  auto keySwitchHint = cc.KeySwitchGen(sk, skN);
+
+  for (LWEPlaintext m = 0; m < 2; m++) {
+    auto ctQN = cc.Encrypt(skN, m, FRESH);
+
+    auto ctKS = cc.GetLWEScheme()->KeySwitch(
+        LWEParams, keySwitchHint,
+        cc.GetLWEScheme()->ModSwitch(LWEParams->GetqKS(), ctQN));
+    auto expected = cc.GetLWEScheme()->ModSwitch(LWEParams->Getq(), ctKS);
+
+    auto ct = cc.GetLWEScheme()->ModKeySwitch(LWEParams, keySwitchHint,
+                                              ctQN->GetA(), ctQN->GetB());
+
+    EXPECT_EQ(expected->GetA(), ct->GetA()) << "Failed fused switch test";
+    EXPECT_EQ(expected->GetB(), ct->GetB()) << "Failed fused switch test";
+
+    LWEPlaintext result;
+    cc.Decrypt(sk, ct, &result);
+    EXPECT_EQ(m, result) << "Failed fused switch test";
+  }
+}
+
+// Checks the flat layout of the switching key, in the compact and in the
+// native storage
+TEST(UnitTestFHEWAP, SwitchingKeyLayout) {
+  auto cc = BinFHEContext();
+
+  cc.GenerateBinFHEContext(TOY, AP);
+
+  auto LWEParams = cc.GetParams()->GetLWEParams();
+  auto sk = cc.KeyGen();
+  auto skN = cc.KeyGenN();
+
+  auto key = cc.KeySwitchGen(sk, skN);
+  EXPECT_EQ(LWEParams->GetN(), key->GetN());
+  EXPECT_EQ(LWEParams->GetBaseKS(), key->GetBaseKS());
+  EXPECT_EQ(LWEParams->GetDigitsKS().size(), key->GetExpKS());
+  EXPECT_EQ(LWEParams->Getn(), key->Getn());
+
+  // the modulus of TOY fits in 32 bits
+  ASSERT_TRUE(key->IsCompact());
+  EXPECT_EQ(0U, key->GetStride() * sizeof(uint32_t) % 64);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(key->GetCompactRow(3, 1, 1)) % 64);
+
+  // the nested form has the same ciphertexts
+  auto elements = key->GetElements();
+  const LWECiphertextImpl &ct = elements[3][1][1];
+  for (uint32_t l = 0; l < key->Getn(); l++)
+    EXPECT_EQ(ct.GetA()[l].ConvertToInt(), key->GetCompactRow(3, 1, 1)[l]);
+  EXPECT_EQ(ct.GetB().ConvertToInt(), key->GetCompactRow(3, 1, 1)[key->Getn()]);
+  EXPECT_EQ(*key, LWESwitchingKey(elements));
+
+  auto ctQN = cc.Encrypt(skN, 1, FRESH);
+  auto compact = cc.GetLWEScheme()->KeySwitch(LWEParams, key, ctQN);
+
+  key->SetCompact(false);
+  EXPECT_FALSE(key->IsCompact());
+  EXPECT_EQ(0U, key->GetStride() * sizeof(LWESwitchingKey::Word) % 64);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(key->GetRow(3, 1, 1)) % 64);
+  for (uint32_t l = 0; l < key->Getn(); l++)
+    EXPECT_EQ(ct.GetA()[l].ConvertToInt(), key->GetRow(3, 1, 1)[l]);
+  EXPECT_EQ(elements, key->GetElements());
+
+  auto native = cc.GetLWEScheme()->KeySwitch(LWEParams, key, ctQN);
+  EXPECT_EQ(compact->GetA(), native->GetA());
+  EXPECT_EQ(compact->GetB(), native->GetB());
+}
+
+// Checks that modulus switching rounds exactly, for powers of two and for
+// the prime moduli of the parameter sets
+TEST(UnitTestFHEW, ModSwitchRounding) {
+  LWEEncryptionScheme scheme;
+  NativeInteger Q27 =
+      PreviousPrime<NativeInteger>(FirstPrime<NativeInteger>(27, 1024), 1024);
+  NativeInteger Q54 =
+      PreviousPrime<NativeInteger>(FirstPrime<NativeInteger>(54, 2048), 2048);
+  std::vector<std::pair<NativeInteger, NativeInteger>> moduli = {
+      {512, Q27},      {1 << 14, Q27}, {1 << 20, Q54}, {Q27, Q54},
+      {512, 1 << 14},  {1024, 512},    {Q27, 1 << 14}};
+
+  for (const auto &m : moduli) {
+    NativeInteger q = m.first;
+    NativeInteger Q = m.second;
+    DiscreteUniformGeneratorImpl<NativeVector> dug;
+    dug.SetModulus(Q);
+    NativeVector a = dug.GenerateVector(256);
+    a[0] = 0;
+    a[1] = Q - 1;
+    a[2] = Q >> 1;
+    auto ct = std::make_shared<LWECiphertextImpl>(a, NativeInteger(1));
+
+    auto ctq = scheme.ModSwitch(q, ct);
+
+    for (uint32_t i = 0; i < a.GetLength(); i++) {
+      unsigned __int128 x = 2 * (unsigned __int128)a[i].ConvertToInt() *
+                                q.ConvertToInt() +
+                            Q.ConvertToInt();
+      uint64_t expected = (x / (2 * (unsigned __int128)Q.ConvertToInt())) %
+                          q.ConvertToInt();
+      ASSERT_EQ(expected, ctq->GetA()[i].ConvertToInt())
+          << "Failed rounding of " << a[i] << " from " << Q << " to " << q;
+    }
+  }
+}
+
 // Checks the mod switching operation
 TEST(UnitTestFHEWGINX, ModSwitch) {
   auto cc = BinFHEContext();
@@ -241,6 +358,31 @@ TEST(UnitTestFHEWAP, Bootstrap) {
   EXPECT_EQ(0, result01) << failed;
 }
 
+// Checks that binary gates split across threads give the same ciphertexts
+// as on the calling thread
+TEST(UnitTestFHEWAP, BootstrapThreads) {
+  auto cc = BinFHEContext();
+  cc.GenerateBinFHEContext(TOY, AP);
+
+  auto sk = cc.KeyGen();
+
+  cc.BTKeyGen(sk);
+
+  auto ct1 = cc.Encrypt(sk, 1);
+  auto ct0 = cc.Encrypt(sk, 0);
+
+  auto ctAND = cc.EvalBinGate(AND, ct1, ct0);
+  auto ctOR = cc.EvalBinGate(OR, ct1, ct0);
+
+  for (uint32_t threads : {2U, 4U}) {
+    cc.SetBootstrapThreads(threads);
+    EXPECT_EQ(*ctAND, *cc.EvalBinGate(AND, ct1, ct0))
+        << "AND with " << threads << " threads failed";
+    EXPECT_EQ(*ctOR, *cc.EvalBinGate(OR, ct1, ct0))
+        << "OR with " << threads << " threads failed";
+  }
+}
+
 // Checks the truth table for AND
 TEST(UnitTestFHEWGINX, Bootstrap) {
   auto cc = BinFHEContext();
@@ -845,6 +987,114 @@ TEST(UnitTestFHEWAP, XNOR_FAST) {
   EXPECT_EQ(1, result00) << failed;
 }
 
+// Checks the truth tables of the gates of three inputs and of threshold
+// gates, each evaluated with one bootstrapping
+TEST(UnitTestFHEWAP, MultiInputGates) {
+  auto cc = BinFHEContext();
+  cc.GenerateBinFHEContext(TOY, AP);
+
+  auto sk = cc.KeyGen();
+
+  cc.BTKeyGen(sk);
+
+  // all inputs of k bits, encrypted with plaintext modulus p
+  auto encrypt = [&](uint32_t bits, uint32_t k, LWEPlaintextModulus p) {
+    std::vector<std::shared_ptr<const LWECiphertextImpl>> cts;
+    for (uint32_t i = 0; i < k; i++)
+      cts.push_back(cc.Encrypt(sk, (bits >> i) & 1, p, FRESH));
+    return cts;
+  };
+  auto decrypt = [&](ConstLWECiphertext ct) {
+    LWEPlaintext result;
+    cc.Decrypt(sk, ct, &result);
+    return result;
+  };
+
+  for (uint32_t bits = 0; bits < 8; bits++) {
+    uint32_t ones = (bits & 1) + ((bits >> 1) & 1) + (bits >> 2);
+    EXPECT_EQ(ones >= 2, decrypt(cc.EvalBinGate(MAJORITY, encrypt(bits, 3, 4))))
+        << "MAJORITY failed for " << bits;
+    EXPECT_EQ(ones == 3, decrypt(cc.EvalBinGate(AND3, encrypt(bits, 3, 6))))
+        << "AND3 failed for " << bits;
+    EXPECT_EQ(ones >= 1, decrypt(cc.EvalBinGate(OR3, encrypt(bits, 3, 6))))
+        << "OR3 failed for " << bits;
+    EXPECT_EQ(ones >= 2,
+              decrypt(cc.EvalThresholdGate(encrypt(bits, 3, 6), 2, 6)))
+        << "Threshold gate failed for " << bits;
+  }
+
+  // two inputs are passed to the gates of two inputs
+  EXPECT_EQ(1, decrypt(cc.EvalBinGate(XOR, encrypt(1, 2, 4))));
+
+  // AND3 is not a single bootstrapping for inputs modulo 4
+  EXPECT_THROW(cc.EvalThresholdGate(encrypt(7, 3, 4), 3, 4), config_error);
+  EXPECT_THROW(cc.EvalThresholdGate(encrypt(7, 3, 6), 4, 6), config_error);
+  EXPECT_THROW(cc.EvalBinGate(AND3, encrypt(3, 2, 6)), config_error);
+  auto ct = cc.Encrypt(sk, 1);
+  EXPECT_THROW(cc.EvalBinGate(MAJORITY, {ct, ct, cc.Encrypt(sk, 1)}),
+               config_error);
+}
+
+// Checks a two-bit adder evaluated as a circuit
+TEST(UnitTestFHEWAP, Circuit) {
+  auto cc = BinFHEContext();
+  cc.GenerateBinFHEContext(TOY, AP);
+
+  auto sk = cc.KeyGen();
+
+  cc.BTKeyGen(sk);
+
+  BinFHECircuit circuit;
+  uint32_t a0 = circuit.AddInput();
+  uint32_t a1 = circuit.AddInput();
+  uint32_t b0 = circuit.AddInput();
+  uint32_t b1 = circuit.AddInput();
+  uint32_t s0 = circuit.AddGate(XOR, a0, b0);
+  uint32_t c0 = circuit.AddGate(AND, a0, b0);
+  uint32_t x1 = circuit.AddGate(XOR, a1, b1);
+  uint32_t s1 = circuit.AddGate(XOR, x1, c0);
+  uint32_t c1 = circuit.AddGate(MAJORITY, {a1, b1, c0});
+  // NOT(c1) AND 1, with the free gates in between
+  uint32_t nc1 = circuit.AddGate(AND, circuit.AddNOT(c1),
+                                 circuit.AddConstant(true));
+  circuit.AddOutput(s0);
+  circuit.AddOutput(s1);
+  circuit.AddOutput(c1);
+  circuit.AddOutput(nc1);
+  circuit.AddOutput(a0);
+
+  EXPECT_EQ(4U, circuit.GetNumInputs());
+  EXPECT_EQ(5U, circuit.GetNumOutputs());
+  EXPECT_EQ(6U, circuit.GetNumBootstraps());
+  EXPECT_EQ(3U, circuit.GetDepth());
+
+  for (uint32_t a = 0; a < 4; a++) {
+    for (uint32_t b = 0; b < 4; b++) {
+      std::vector<std::shared_ptr<const LWECiphertextImpl>> inputs = {
+          cc.Encrypt(sk, a & 1), cc.Encrypt(sk, a >> 1), cc.Encrypt(sk, b & 1),
+          cc.Encrypt(sk, b >> 1)};
+      auto outputs = cc.EvalCircuit(circuit, inputs);
+      ASSERT_EQ(5U, outputs.size());
+
+      std::vector<LWEPlaintext> result(outputs.size());
+      for (uint32_t i = 0; i < outputs.size(); i++)
+        cc.Decrypt(sk, outputs[i], &result[i]);
+      uint32_t sum = a + b;
+      EXPECT_EQ(sum & 1, result[0]) << a << " + " << b;
+      EXPECT_EQ((sum >> 1) & 1, result[1]) << a << " + " << b;
+      EXPECT_EQ(sum >> 2, result[2]) << a << " + " << b;
+      EXPECT_EQ(1 - (sum >> 2), result[3]) << a << " + " << b;
+      EXPECT_EQ(a & 1, result[4]) << a << " + " << b;
+    }
+  }
+
+  EXPECT_THROW(circuit.AddGate(AND, a0, a0), config_error);
+  EXPECT_THROW(circuit.AddGate(AND, a0, 100), config_error);
+  EXPECT_THROW(circuit.AddGate(MAJORITY, a0, b0), config_error);
+  EXPECT_THROW(circuit.AddGate(AND, {a0, a1, b0}), config_error);
+  EXPECT_THROW(cc.EvalCircuit(circuit, {cc.Encrypt(sk, 1)}), config_error);
+}
+
 // Checks the truth table for XOR
 TEST(UnitTestFHEWGINX, XNOR_FAST) {
   auto cc = BinFHEContext();
@@ -880,3 +1130,193 @@ TEST(UnitTestFHEWGINX, XNOR_FAST) {
   EXPECT_EQ(0, result10) << failed;
   EXPECT_EQ(1, result00) << failed;
 }
+
+// Checks the fused linear layer against ModMul/ModAdd, both with a modulus
+// that allows lazy reduction and with one that does not
+TEST(UnitTestLWE, EvalLWELinear) {
+  LWEEncryptionScheme scheme;
+  const uint32_t n = 37;
+  const uint32_t numIn = 50;
+  const uint32_t numOut = 7;
+
+  for (NativeInteger q : {NativeInteger(1) << 30, NativeInteger(1) << 40}) {
+    DiscreteUniformGeneratorImpl<NativeVector> dug;
+    dug.SetModulus(q);
+
+    std::vector<std::shared_ptr<LWECiphertextImpl>> inputs;
+    for (uint32_t i = 0; i < numIn; i++)
+      inputs.push_back(std::make_shared<LWECiphertextImpl>(
+          dug.GenerateVector(n), dug.GenerateInteger()));
+    std::vector<LWECiphertextImpl> biases;
+    for (uint32_t j = 0; j < numOut; j++)
+      biases.push_back(
+          LWECiphertextImpl(dug.GenerateVector(n), dug.GenerateInteger()));
+
+    // small signed weights as in DiNN, plus full-range rows that force
+    // intermediate reductions
+    NativeVector W(numIn * numOut, q);
+    for (uint32_t k = 0; k < numIn * numOut; k++)
+      W[k] = (k / numIn < 4) ? q.ModSub(NativeInteger(k % 19), q)
+                               .ModAdd(NativeInteger(9), q)
+                             : dug.GenerateInteger();
+
+    std::vector<std::shared_ptr<LWECiphertextImpl>> outputs;
+    scheme.EvalLWELinear(W, inputs, biases, &outputs);
+    ASSERT_EQ(numOut, outputs.size());
+
+    for (uint32_t j = 0; j < numOut; j++) {
+      LWECiphertextImpl expected(biases[j]);
+      LWECiphertextImpl scaled(biases[j]);
+      for (uint32_t i = 0; i < numIn; i++) {
+        const NativeInteger &w = W[j * numIn + i];
+        expected.SetA(inputs[i]->GetA().ModMul(w).ModAdd(expected.GetA()));
+        expected.SetB(
+            inputs[i]->GetB().ModMul(w, q).ModAdd(expected.GetB(), q));
+        scaled.AddScaledEq(*inputs[i], w);
+      }
+      EXPECT_EQ(expected, *outputs[j]) << "EvalLWELinear failed, q = " << q;
+      EXPECT_EQ(expected, scaled) << "AddScaledEq failed, q = " << q;
+    }
+
+    // preallocated outputs are overwritten in place
+    auto out0 = outputs[0];
+    scheme.EvalLWELinear(W, inputs, biases, &outputs);
+    EXPECT_EQ(out0, outputs[0]);
+  }
+}
+
+// Checks the accumulator updates that use the per-thread workspace, with and
+// without the Shoup constants of the keys, against the external product
+// computed with the polynomial operators
+TEST(UnitTestFHEWGINX, AddToACC) {
+  auto cc = BinFHEContext();
+  cc.GenerateBinFHEContext(TOY, GINX);
+  auto sk = cc.KeyGen();
+  cc.BTKeyGen(sk);
+
+  auto params = cc.GetParams();
+  auto scheme = cc.GetRingGSWScheme();
+  const auto &input1 = (*cc.GetRefreshKey())[0][0][0];
+  const auto &input2 = (*cc.GetRefreshKey())[0][1][0];
+  EXPECT_TRUE(input1.HasShoup());
+  // the same keys without the Shoup constants
+  RingGSWCiphertext plain1, plain2;
+  plain1.SetElements(input1.GetElements());
+  plain2.SetElements(input2.GetElements());
+  uint32_t N = params->GetLWEParams()->GetN();
+  uint32_t digitsG2 = params->GetDigitsG2();
+
+  DiscreteUniformGeneratorImpl<NativeVector> dug;
+  dug.SetModulus(params->GetLWEParams()->GetQ());
+  RingGSWCiphertext acc(1, 2);
+  for (uint32_t j = 0; j < 2; j++) {
+    acc[0][j] = NativePoly(params->GetPolyParams(), Format::COEFFICIENT);
+    acc[0][j].SetValues(dug.GenerateVector(N), Format::COEFFICIENT);
+    acc[0][j].SetFormat(Format::EVALUATION);
+  }
+
+  SpinTeam team2(2);
+  SpinTeam team3(3);
+
+  // repeated calls reuse the workspace, so the stale digits of one call
+  // must not leak into the next one
+  for (uint32_t a : {5U, 0U, N + 3}) {
+    auto ct = acc.GetElements()[0];
+    for (auto &c : ct) c.SetFormat(Format::COEFFICIENT);
+    std::vector<NativePoly> dct(
+        digitsG2,
+        NativePoly(params->GetPolyParams(), Format::COEFFICIENT, true));
+    scheme->SignedDigitDecompose(params, ct, &dct);
+    for (auto &d : dct) d.SetFormat(Format::EVALUATION);
+
+    std::vector<NativePoly> expected = acc.GetElements()[0];
+    // the monomial index for sk = -1 as AddToACCGINX computes it
+    uint32_t aNeg = params->GetLWEParams()
+                        ->Getq()
+                        .ModSub(NativeInteger(a), NativeInteger(2 * N))
+                        .ConvertToInt();
+    for (uint32_t j = 0; j < 2; j++) {
+      NativePoly prod1 = dct[0] * input1[0][j];
+      NativePoly prod2 = dct[0] * input2[0][j];
+      for (uint32_t l = 1; l < digitsG2; l++) {
+        prod1 += dct[l] * input1[l][j];
+        prod2 += dct[l] * input2[l][j];
+      }
+      expected[j] += prod1 * params->GetMonomial(a);
+      expected[j] += prod2 * params->GetMonomial(aNeg);
+    }
+
+    auto accPlain = std::make_shared<RingGSWCiphertext>(acc);
+    scheme->AddToACCGINX(params, plain1, plain2, NativeInteger(a), accPlain);
+    EXPECT_EQ(expected, accPlain->GetElements()[0])
+        << "AddToACCGINX failed, a = " << a;
+
+    auto accPtr = std::make_shared<RingGSWCiphertext>(acc);
+    scheme->AddToACCGINX(params, input1, input2, NativeInteger(a), accPtr);
+    EXPECT_EQ(expected, accPtr->GetElements()[0])
+        << "AddToACCGINX with Shoup constants failed, a = " << a;
+
+    // two threads merge the decomposition and the NTTs, three do not
+    for (SpinTeam *team : {&team2, &team3}) {
+      auto accTeam = std::make_shared<RingGSWCiphertext>(acc);
+      scheme->AddToACCGINX(params, input1, input2, NativeInteger(a), accTeam,
+                           team);
+      EXPECT_EQ(expected, accTeam->GetElements()[0])
+          << "AddToACCGINX with " << team->GetNumThreads()
+          << " threads failed, a = " << a;
+    }
+    acc = *accPtr;
+  }
+}
+
+// Checks that the signed digits are centered and recompose the centered
+// input up to a multiple of baseG^digitsG (the last digit is only the
+// remainder modulo baseG)
+TEST(UnitTestFHEWGINX, SignedDigitDecompose) {
+  auto cc = BinFHEContext();
+  cc.GenerateBinFHEContext(TOY, GINX);
+
+  auto params = cc.GetParams();
+  NativeInteger Q = params->GetLWEParams()->GetQ();
+  uint32_t N = params->GetLWEParams()->GetN();
+  uint32_t digitsG = params->GetDigitsG();
+  int64_t baseG = params->GetBaseG();
+
+  DiscreteUniformGeneratorImpl<NativeVector> dug;
+  dug.SetModulus(Q);
+  std::vector<NativePoly> input(
+      2, NativePoly(params->GetPolyParams(), Format::COEFFICIENT));
+  for (auto &c : input) c.SetValues(dug.GenerateVector(N), Format::COEFFICIENT);
+  // the edges of the centered range
+  input[0][0] = 0;
+  input[0][1] = Q >> 1;
+  input[0][2] = (Q >> 1) + NativeInteger(1);
+  input[0][3] = Q - NativeInteger(1);
+
+  std::vector<NativePoly> output(
+      2 * digitsG, NativePoly(params->GetPolyParams(), Format::COEFFICIENT,
+                              true));
+  cc.GetRingGSWScheme()->SignedDigitDecompose(params, input, &output);
+
+  int64_t QInt = Q.ConvertToInt();
+  int64_t range = 1;
+  for (uint32_t l = 0; l < digitsG; l++) range *= baseG;
+
+  for (uint32_t j = 0; j < 2; j++) {
+    for (uint32_t k = 0; k < N; k++) {
+      int64_t t = input[j][k].ConvertToInt();
+      if (t >= QInt / 2) t -= QInt;
+      int64_t sum = 0;
+      int64_t power = 1;
+      for (uint32_t l = 0; l < digitsG; l++, power *= baseG) {
+        int64_t digit = output[j + 2 * l][k].ConvertToInt();
+        if (digit > QInt / 2) digit -= QInt;
+        EXPECT_LE(-baseG / 2, digit);
+        EXPECT_GT(baseG / 2, digit);
+        sum += digit * power;
+      }
+      EXPECT_EQ(0, (sum - t) % range)
+          << "SignedDigitDecompose failed, j = " << j << ", k = " << k;
+    }
+  }
+}
@@ -249,3 +249,61 @@ TEST(UnitTestFHEWSerialGINX, BINARY) {
 
   EXPECT_EQ(*ct111, *ct) << msg << " Ciphertext mismatch";
 }
+
+// Checks the streaming key generation: the refreshing key written to the
+// stream is read back and bootstraps, and the progress is reported
+TEST(UnitTestFHEWSerialAP, KeyGenStream) {
+  auto cc = BinFHEContext();
+  cc.GenerateBinFHEContext(TOY, AP);
+  auto params = cc.GetParams();
+
+  auto sk = cc.KeyGen();
+
+  auto scheme = cc.GetRingGSWScheme();
+  scheme->SetKeyGenThreads(2);
+  EXPECT_GE(2U, scheme->GetKeyGenThreads());
+  std::vector<uint32_t> done;
+  uint32_t total = 0;
+  scheme->SetKeyGenProgress([&](uint32_t d, uint32_t t) {
+    done.push_back(d);
+    total = t;
+  });
+
+  std::stringstream s;
+  auto keys = scheme->KeyGen(params, cc.GetLWEScheme(), sk, s);
+  scheme->SetKeyGenProgress(nullptr);
+  scheme->SetKeyGenThreads(0);
+
+  EXPECT_EQ(nullptr, keys.BSkey);
+  ASSERT_NE(nullptr, keys.KSkey);
+  EXPECT_EQ(params->GetLWEParams()->Getn() * params->GetBaseR() *
+                params->GetDigitsR().size(),
+            total);
+  ASSERT_FALSE(done.empty());
+  EXPECT_TRUE(std::is_sorted(done.begin(), done.end()));
+  EXPECT_EQ(total, done.back());
+
+  std::string stream = s.str();
+  std::stringstream in(stream);
+  auto refreshKey = ReadRingGSWBTKey(in, params);
+  EXPECT_TRUE((*refreshKey)[0][0][0].GetElements().empty());
+  EXPECT_TRUE((*refreshKey)[0][1][0].HasShoup());
+
+  cc.BTKeyLoad({refreshKey, keys.KSkey});
+  auto ct0 = cc.Encrypt(sk, 0);
+  auto ct1 = cc.Encrypt(sk, 1);
+  auto ct1b = cc.Encrypt(sk, 1);
+  LWEPlaintext result;
+  cc.Decrypt(sk, cc.EvalBinGate(AND, ct1, ct1b), &result);
+  EXPECT_EQ(1, result) << "AND with the streamed key failed";
+  cc.Decrypt(sk, cc.EvalBinGate(AND, ct1, ct0), &result);
+  EXPECT_EQ(0, result) << "AND with the streamed key failed";
+
+  // corrupted and truncated streams are rejected
+  std::string corrupted = stream;
+  corrupted[corrupted.size() / 2] ^= 1;
+  std::stringstream corruptedIn(corrupted);
+  EXPECT_THROW(ReadRingGSWBTKey(corruptedIn, params), deserialize_error);
+  std::stringstream truncatedIn(stream.substr(0, stream.size() - 1));
+  EXPECT_THROW(ReadRingGSWBTKey(truncatedIn, params), deserialize_error);
+}
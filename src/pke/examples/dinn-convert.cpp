@@ -0,0 +1,79 @@
+// @file  dinn-convert.cpp - Converts DiNN text files to the binary container.
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "dinnfile.h"
+#include "utils/exception.h"
+
+using namespace lbcrypto;
+
+void usage() {
+  std::cerr << "usage:" << std::endl
+            << "  dinn-convert model <weights.txt> <biases.txt> <topology, "
+               "e.g. 256:30:10> <out> [plaintext modulus]"
+            << std::endl
+            << "  dinn-convert dataset <images.txt> <labels.txt> <number of "
+               "images> <image size> <out>"
+            << std::endl;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  std::string kind(argv[1]);
+  std::string out;
+
+  try {
+    if (kind == "model" && (argc == 6 || argc == 7)) {
+      std::vector<uint32_t> topology;
+      std::stringstream ss(argv[4]);
+      std::string dim;
+      while (std::getline(ss, dim, ':')) topology.push_back(std::stoul(dim));
+      uint64_t p = (argc == 7) ? std::stoull(argv[6]) : 0;
+      out = argv[5];
+      DiNNFile::ConvertModelText(argv[2], argv[3], topology, out, p);
+    } else if (kind == "dataset" && argc == 7) {
+      out = argv[6];
+      DiNNFile::ConvertDatasetText(argv[2], argv[3], std::stoul(argv[4]),
+                                   std::stoul(argv[5]), out);
+    } else {
+      usage();
+      return 1;
+    }
+
+    DiNNFile file(out);
+    std::cout << "Wrote " << out << ", shape";
+    for (auto d : file.GetShape()) std::cout << " " << d;
+    std::cout << ", " << file.GetDType() << " byte(s) per value" << std::endl;
+  } catch (const palisade_error &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -22,6 +22,7 @@
 
 
 // Includes
+#define PROFILE  // for TIC/TOC
 #include <bits/types/time_t.h>
 #include <stdio.h>
 #include <cstddef>
@@ -37,16 +38,13 @@
 #include <string>
 #include "math/backend.h"
 #include <sys/time.h>
-// Multi-processing
-#include <sys/wait.h>
-#include <unistd.h>
-#include <ctime>
 
 //! binfhecontext
-#define PROFILE
 #include <vector>
 // #include "binfhecontext.h"
 #include "palisade.h"
+#include "dinnengine.h"
+#include "utils/stageprofiler.h"
 using namespace lbcrypto;
 
 
@@ -54,7 +52,9 @@ using namespace lbcrypto;
 #define VERBOSE 1
 #define STATISTICS true
 #define WRITELATEX false
-#define N_PROC 1
+#define PROFILE_STAGES true   // latency histograms of the stages
+#define N_THREADS 0   // 0 uses all available threads
+#define QUEUE_DEPTH 4 // images in flight between the pipeline stages
 
 // Security constants
 #define SECLEVEL 80
@@ -81,13 +81,21 @@ using namespace lbcrypto;
 #define CARD_TESTSET 2
 
 // Files are expected in the executable's directory
-#define PATH_TO_FILES       "buildotests/test/" //TODO FIXME!
-#define FILE_TXT_IMG        "../../../weights-and-biases/txt_img_test.txt"
-#define FILE_TXT_BIASES     "../../../weights-and-biases/txt_biases.txt"
-#define FILE_TXT_WEIGHTS    "../../../weights-and-biases/txt_weights.txt"
-#define FILE_TXT_LABELS     "../../../weights-and-biases/txt_labels.txt"
+// The model and the test set are binary DiNN files given on the command line:
+//     nn_multi_pke [model.dinn] [testset.dinn]
+// By default they are looked up in DATA_DIR and converted from the text files
+// there on first use (see also dinn-convert)
+#define DATA_DIR            "../../../weights-and-biases/"
+#define FILE_MODEL          DATA_DIR "model.dinn"
+#define FILE_TESTSET        DATA_DIR "testset.dinn"
+#define FILE_TXT_IMG        DATA_DIR "txt_img_test.txt"
+#define FILE_TXT_BIASES     DATA_DIR "txt_biases.txt"
+#define FILE_TXT_WEIGHTS    DATA_DIR "txt_weights.txt"
+#define FILE_TXT_LABELS     DATA_DIR "txt_labels.txt"
+#define CARD_TESTSET_TXT    10000   // images in FILE_TXT_IMG
 #define FILE_LATEX          "results_LaTeX.tex"
 #define FILE_STATISTICS     "results_stats.txt"
+#define FILE_PROFILE        "results_profile.json"
 
 // Tweak neural network
 #define THRESHOLD_WEIGHTS  9
@@ -99,9 +107,6 @@ using namespace lbcrypto;
 
 using namespace std;
 
-void deleteTensor(int*** tensor, int dim_mat, const int* dim_vec);
-void deleteMatrix(int**  matrix, int dim_mat);
-
 
 
 
@@ -110,52 +115,11 @@ int main(int argc, char **argv)
     // Security
     const bool noisyLWE      = SECNOISE;
 
-    // Input data
-    const int n_images = CARD_TESTSET;
-    const int slice = (n_images+N_PROC-1)/N_PROC;
-
-    // Network specific
-    const int num_wire_layers = NUM_NEURONS_LAYERS - 1;
-    const int num_neuron_layers = NUM_NEURONS_LAYERS;
-    const int num_neurons_in = NUM_NEURONS_INPUT;
-    const int num_neurons_hidden = NUM_NEURONS_HIDDEN;
-    const int num_neurons_out = NUM_NEURONS_OUTPUT;
-
-    // Vector of number of neurons in layer_in, layer_H1, layer_H2, ..., layer_Hd, layer_out;
-    const int topology[num_neuron_layers] = {num_neurons_in, num_neurons_hidden, num_neurons_out};
-
-
-    const bool clamp_biases  = false;
-    const bool clamp_weights = false;
-
     const bool statistics        = STATISTICS;
     const bool writeLaTeX_result = WRITELATEX;
 
-    const int threshold_biases  = THRESHOLD_WEIGHTS;
-    const int threshold_weights = THRESHOLD_WEIGHTS;
     const int threshold_scores  = THRESHOLD_SCORE;
 
-    // Program the wheel to value(s) after Bootstrapping
-    // const Torus32 mu_boot = modSwitchToTorus32(1, space_after_bs);
-
-    const int total_num_hidden_neurons = n_images * NUM_NEURONS_HIDDEN;  //TODO (sum all num_neurons_hidden)*n_images
-    const double avg_bs  = 1./NUM_NEURONS_HIDDEN;
-    const double avg_total_bs  = 1./total_num_hidden_neurons;
-    const double avg_img = 1./n_images;
-    const double clocks2seconds = 1. / CLOCKS_PER_SEC;
-
-    // Huge arrays
-    int*** weights = new int**[num_wire_layers];  // allocate and fill matrices holding the weights
-    NativeInteger*** weights_1 = new NativeInteger**[num_wire_layers];
-    int ** biases  = new int* [num_wire_layers];  // allocate and fill vectors holding the biases
-    int ** images  = new int* [n_images];
-    int  * labels  = new int  [n_images];
-
-    // Temporary variables
-    string line;
-    int el, l;
-    int num_neurons_current_layer_in, num_neurons_current_layer_out;
-
     //! binfhecontext strat
     auto cc = CryptoContextImpl<DCRTPoly>();
 
@@ -164,7 +128,6 @@ int main(int argc, char **argv)
     int p = 512;
 
     cc.Generate_Default_params();
-    int q = cc.HESea_GetParams()->GetLWEParams()->Getq().ConvertToInt();
 
 
     // Sample Program: Step 2: Key Generation
@@ -192,131 +155,46 @@ int main(int argc, char **argv)
         }
     }
 
-    if (VERBOSE) cout << "IMPORT PIXELS, WEIGHTS, BIASES, and LABELS FROM FILES" << endl;
-    if (VERBOSE) cout << "Reading images (regardless of dimension) from " << FILE_TXT_IMG << endl;
-    ifstream file_images(FILE_TXT_IMG);
-
-    for (int img=0; img<n_images; ++img)
-        images[img] = new int[num_neurons_in];
-
-    int filling_image = 0;
-    int image_count = 0;
-    while(getline(file_images, line))
+    string file_model   = (argc > 1) ? argv[1] : FILE_MODEL;
+    string file_testset = (argc > 2) ? argv[2] : FILE_TESTSET;
+    if (argc <= 1 && !ifstream(file_model).good())
     {
-        images[filling_image][image_count++] = stoi(line);
-        if (image_count == num_neurons_in)
-        {
-            image_count = 0;
-            filling_image++;
-        }
-        if (filling_image>=n_images) break;
+        if (VERBOSE) cout << "Converting " << FILE_TXT_WEIGHTS << " and " << FILE_TXT_BIASES << " to " << file_model << endl;
+        DiNNFile::ConvertModelText(FILE_TXT_WEIGHTS, FILE_TXT_BIASES, {NUM_NEURONS_INPUT, NUM_NEURONS_HIDDEN, NUM_NEURONS_OUTPUT}, file_model, p);
     }
-    file_images.close();
-
-
-    if (VERBOSE) cout << "Reading weights from " << FILE_TXT_WEIGHTS << endl;
-    ifstream file_weights(FILE_TXT_WEIGHTS);
-
-    num_neurons_current_layer_out = topology[0];
-    for (l=0; l<num_wire_layers; ++l)
+    if (argc <= 2 && !ifstream(file_testset).good())
     {
-        num_neurons_current_layer_in = num_neurons_current_layer_out;
-        num_neurons_current_layer_out = topology[l+1];
-
-        weights[l] = new int*[num_neurons_current_layer_in];
-        weights_1[l] = new NativeInteger*[num_neurons_current_layer_in];
-        for (int i = 0; i<num_neurons_current_layer_in; ++i)
-        {
-            weights[l][i] = new int[num_neurons_current_layer_out];
-            weights_1[l][i] = new NativeInteger[num_neurons_current_layer_out];
-            for (int j=0; j<num_neurons_current_layer_out; ++j)
-            {
-                getline(file_weights, line);
-                el = stoi(line);
-                if (clamp_weights)
-                {
-                    if (el < -threshold_weights)
-                        el = -threshold_weights;
-                    else if (el > threshold_weights)
-                        el = threshold_weights;
-                    // else, nothing as it holds that: -threshold_weights < el < threshold_weights
-                }
-                weights[l][i][j] = el;
-                // NativeInteger a = NativeInteger((el+p)%p);
-                weights_1[l][i][j] = NativeInteger((el+q)%q);
-            }
-        }
+        if (VERBOSE) cout << "Converting " << FILE_TXT_IMG << " and " << FILE_TXT_LABELS << " to " << file_testset << endl;
+        DiNNFile::ConvertDatasetText(FILE_TXT_IMG, FILE_TXT_LABELS, CARD_TESTSET_TXT, NUM_NEURONS_INPUT, file_testset);
     }
-    file_weights.close();
-
-
-    if (VERBOSE) cout << "Reading biases from " << FILE_TXT_BIASES << endl;
-    ifstream file_biases(FILE_TXT_BIASES);
-
-    num_neurons_current_layer_out = topology[0];
-    for (l=0; l<num_wire_layers; ++l)
-    {
-        num_neurons_current_layer_in = num_neurons_current_layer_out;
-        num_neurons_current_layer_out = topology[l+1];
 
-        biases [l] = new int [num_neurons_current_layer_out];
-        for (int j=0; j<num_neurons_current_layer_out; ++j)
-        {
-            getline(file_biases, line);
-            el = stoi(line);
-            if (clamp_biases)
-            {
-                if (el < -threshold_biases)
-                    el = -threshold_biases;
-                else if (el > threshold_biases)
-                    el = threshold_biases;
-                // else, nothing as it holds that: -threshold_biases < el < threshold_biases
-            }
-            biases[l][j] = el;
-        }
-    }
-    file_biases.close();
+    if (VERBOSE) cout << "Mapping the model " << file_model << " and the test set " << file_testset << endl;
+    DiNNFile model_file(file_model);
+    DiNNFile testset(file_testset);
 
+    // The model is built once; the engine shares it and the bootstrapping key
+    // between its worker threads, and hands the images out dynamically
+    auto model = std::make_shared<EncryptedDiscretizedNet<DCRTPoly>>(cc, model_file, p);
+    DiNNInferenceEngine<DCRTPoly> engine(model, N_THREADS);
 
-    if (VERBOSE) cout << "Reading labels from " << FILE_TXT_LABELS << endl;
-    ifstream file_labels(FILE_TXT_LABELS);
-    for (int img=0; img<n_images; ++img)
+    // Vector of number of neurons in layer_in, layer_H1, layer_H2, ..., layer_Hd, layer_out;
+    const vector<uint32_t>& topology = model->GetTopology();
+    const int num_neurons_in = topology.front();
+    const int num_neurons_out = topology.back();
+    if (testset.GetImageSize() != (uint32_t)num_neurons_in)
     {
-        getline(file_labels, line);
-        labels[img] = stoi(line);
+        cerr << "The images of " << file_testset << " do not match the input layer of " << file_model << endl;
+        return 1;
     }
-    file_labels.close();
-
-    if (VERBOSE) cout << "Import done. END OF IMPORT" << endl;
-
-
-    int** weight_layer;
-    int * bias;
-    int * image;
-    int pixel, label;
-    int x, w, w0;
-
-
-    NativeInteger w_1;
-    vector<LWECiphertext> enc_imgae_1;
-    vector<LWECiphertext> multi_sum_1;
-    vector<LWECiphertext> bootstrapped_1;
-
-
-
-    int multi_sum_clear[num_neurons_hidden];
-    int output_clear   [num_neurons_out];
-
-    int max_score = 0;
-    int max_score_clear = 0;
-    int class_enc = 0;
-    int class_clear = 0;
-    int score = 0;
-    LWEPlaintext score_1;
-    int score_clear = 0;
 
+    const int n_images = min<int>(CARD_TESTSET, testset.GetNumImages());
+    int num_hidden_neurons = 0;
+    for (size_t l = 1; l + 1 < topology.size(); ++l)
+        num_hidden_neurons += topology[l];
+    const int total_num_hidden_neurons = n_images * num_hidden_neurons;
+    const double avg_total_bs  = 1./total_num_hidden_neurons;
+    const double avg_img = 1./n_images;
 
-    bool failed_bs = false;
     // Counters
     int count_errors = 0;
     int count_errors_with_failed_bs = 0;
@@ -325,291 +203,134 @@ int main(int argc, char **argv)
     int count_disag_pro_clear = 0;
     int count_disag_pro_hom = 0;
     int count_wrong_bs = 0;
+    bool failed_bs = false;
 
-    int r_count_errors, r_count_disagreements, r_count_disag_pro_clear, r_count_disag_pro_hom, r_count_wrong_bs, r_count_errors_with_failed_bs, r_count_disagreements_with_failed_bs;
-    double r_total_time_network, r_total_time_bootstrappings;
-
-    // For statistics output
-    double avg_time_per_classification = 0.0;
-    double avg_time_per_bootstrapping = 0.0;
-    double total_time_bootstrappings = 0.0;
-    double total_time_network = 0.0;
-    double error_rel_percent = 0.0;
-
-    // Timings
-    clock_t bs_begin, bs_end, net_begin, net_end;
-    double time_per_classification, time_per_bootstrapping, time_bootstrappings;
-
-    time_t begin, end;
-    begin = time(NULL);
-
-    pid_t pids[N_PROC];
-    int pipes[N_PROC][2];
-
-    for (int id_proc=0; id_proc < N_PROC; ++id_proc)
+    // Client side: encrypt the pixels of the next image (LWE samples), while
+    // the server evaluates the previous ones
+    auto encrypt_image = [&](size_t img, vector<LWECiphertext> *enc_image)
     {
-        pipe(pipes[id_proc]);   // before fork!
-        pid_t pid = fork();
-        if (pid != 0)
+        if (img >= (size_t)n_images)
+            return false;
+        vector<int64_t> image = testset.GetImage(img);
+        StageTimer timer("dinn.encrypt");
+        for (int i = 0; i < num_neurons_in; ++i)
         {
-            pids [id_proc] = pid;
-            close(pipes[id_proc][1]);
+            int64_t pixel = image[i];
+            if (noisyLWE)
+                //! Encryt message with modulus p
+                enc_image->push_back(cc.HESea_Encrypt(sk, (pixel+p) % p, p));
+            else
+                //! Encrypt message without noise
+                enc_image->push_back(cc.HESea_TraivlEncrypt((pixel+p) % p, p));
         }
-        else
+        return true;
+    };
+
+    // Client side: decrypt the scores of each classified image and compare
+    // them with the evaluation in the clear
+    auto score_image = [&](size_t img, const vector<LWECiphertext> &enc_scores)
+    {
+        int label = testset.GetLabel(img);
+
+        // ========  CLEAR EVALUATION  ========
+        vector<int64_t> clear_out = model->InferClear(testset.GetImage(img));
+
+        // ========  DECRYPT THE SCORES  ========
+        StageTimer timer("dinn.decrypt");
+        int max_score = threshold_scores;
+        int max_score_clear = threshold_scores;
+        int class_enc = 0;
+        int class_clear = 0;
+        for (int j=0; j<num_neurons_out; ++j)
         {
-            close(pipes[id_proc][0]);
-            for (int img = id_proc*slice; img < ( (id_proc+1)*slice) && (img< n_images); /*img*/ )
+            LWEPlaintext score;
+            cc.HESea_Decrypt(sk, enc_scores[j], &score, p);
+            score = (score>p/2)? score%p-p: score%p;
+            if (score > max_score)
             {
-                image = images[img];
-                label = labels[img];
-                ++img;
-
-                // Generate encrypted inputs for NN (LWE samples for each image's pixels on the fly)
-                // To be generic...
-                num_neurons_current_layer_out= topology[0];
-                num_neurons_current_layer_in = num_neurons_current_layer_out;
-
-                for (int i = 0; i < num_neurons_current_layer_in; ++i)
-                {
-                    pixel = image[i];
-                    if (noisyLWE)
-                    {
-                        //! Encryt message with modulus p
-                        auto ct = cc.HESea_Encrypt(sk, (pixel+p) % p, p);
-                        enc_imgae_1.push_back(ct);
-                    }
-                    else
-                    {
-                        //! Encrypt message without noise
-                        cc.HESea_TraivlEncrypt((pixel+p) % p, p);
-                    }
-                }
-
-                // ========  FIRST LAYER(S)  ========
-                net_begin = clock();
-
-                for (l=0; l<num_wire_layers - 1 ; ++l)     // Note: num_wire_layers - 1 iterations; last one is special. Access weights from level l to l+1.
-                {
-                    // To be generic...
-                    num_neurons_current_layer_in = num_neurons_current_layer_out;
-                    num_neurons_current_layer_out= topology[l+1];
-                    bias = biases[l];
-                    weight_layer = weights[l];
-                    for (int j=0; j<num_neurons_current_layer_out; ++j)
-                    {
-                        w0 = bias[j];
-                        multi_sum_clear[j] = w0;
-                        auto ct = cc.HESea_TraivlEncrypt((w0 + p) % p, p);
-                        multi_sum_1.push_back(ct);
-                        for (int i=0; i<num_neurons_current_layer_in; ++i)
-                        {
-                            //! compute in plaintext
-                            x = image [i];  // clear input
-                            w = weight_layer[i][j];  // w^dagger
-                            multi_sum_clear[j] += x * w; // process clear input
-
-                            //! compute in ciphertext
-                            w_1 = weights_1[l][i][j];
-                            const NativeVector temp_A = enc_imgae_1[i]->GetA().ModMul(w_1);
-                            auto temp_B = enc_imgae_1[i]->GetB().ModMul(w_1, q);
-                            multi_sum_1[j]->SetA(temp_A.ModAdd(multi_sum_1[j]->GetA()));
-                            multi_sum_1[j]->SetB(temp_B.ModAdd(multi_sum_1[j]->GetB(), q));
-                        }
-                    }
-                }
-
-
-                    
-                // Bootstrap multi_sum
-                // bootstrapped = new_LweSample_array(num_neurons_current_layer_out, in_out_params);
-                bs_begin = clock();
-                for (int j=0; j<num_neurons_current_layer_out; ++j)
-                {
-                    //! signfunc by our method
-                    auto ct_sign = cc.HESea_MyEvalSigndFunc(multi_sum_1[j], p);
-                    bootstrapped_1.push_back(ct_sign);
-                    if(test_BF){
-                        LWEPlaintext temp,temp1;
-                        cc.HESea_Decrypt(sk, ct_sign, &temp, p);
-                        cc.HESea_Decrypt(sk, multi_sum_1[j], &temp1, p);
-                        temp = (temp<p/2)? temp:temp-p;
-                        temp1 = (temp1<p/2)? temp1:temp1-p;
-                        if (temp*multi_sum_clear[j] <= 0 || true){
-                            cout<<"True value before bootstrapping is "<<multi_sum_clear[j]<< "   " ;
-                            cout<<temp1<<"                ";
-                            cout<<temp<<endl;
-                        } 
-                    }
-
-                }
-                bs_end = clock();
-                time_bootstrappings = bs_end - bs_begin;
-                // cout<< time_bootstrappings;
-                total_time_bootstrappings += time_bootstrappings;
-                time_per_bootstrapping = time_bootstrappings*avg_bs;
-                // if (VERBOSE) cout <<  time_per_bootstrapping*clocks2seconds << " [sec/bootstrapping]" << endl;
-
-                //! clear the vector mult_sum_1 to compute the next layer 
-                multi_sum_1.clear();
-                // ========  LAST (SECOND) LAYER  ========
-                max_score = threshold_scores;
-                max_score_clear = threshold_scores;
-
-                bias = biases[l];
-                weight_layer = weights[l];
-                l++;
-                num_neurons_current_layer_in = num_neurons_current_layer_out;
-                num_neurons_current_layer_out= topology[l]; // l == L = 2
-
-                for (int j=0; j<num_neurons_current_layer_out; ++j)
-                {
-                    w0 = bias[j];
-                    output_clear[j] = w0;
-                    auto ct = cc.HESea_TraivlEncrypt((w0 + p) % p, p);
-                    multi_sum_1.push_back(ct);                 
-
-                    for (int i=0; i<num_neurons_current_layer_in; ++i)
-                    {
-                        w = weight_layer[i][j];
-                        w_1 = weights_1[l-1][i][j]; 
-
-                        // process the encrypted data 
-                        auto temp_A = bootstrapped_1[i]->GetA().ModMul(w_1);
-                        auto temp_B = bootstrapped_1[i]->GetB().ModMulFast(w_1, bootstrapped_1[i]->GetA().GetModulus());
-                        multi_sum_1[j]->SetA(temp_A.ModAdd(multi_sum_1[j]->GetA()));
-                        multi_sum_1[j]->SetB(temp_B.ModAdd(multi_sum_1[j]->GetB(), q));
-
-                        // process clear input
-                        if (multi_sum_clear[i] < 0)
-                            output_clear[j] -= w;
-                        else
-                            output_clear[j] += w;
-                    }
-
-                    //! Decrypt here 
-                    cc.HESea_Decrypt(sk, multi_sum_1[j], &score_1, p);
-                    score_1 = (score_1>p/2)? score_1%p-p: score_1%p;
-                    if (score_1 > max_score)
-                    {
-                        max_score = score_1;
-                        class_enc = j;
-                    }
-                    score_clear = output_clear[j];
-                    if (score_clear > max_score_clear)
-                    {
-                        max_score_clear = score_clear;
-                        class_clear = j;
-                    }
-                }
-                            
-                if (class_enc != label)
-                {
-                    count_errors++;
-                    if (failed_bs)
-                        count_errors_with_failed_bs++;
-                }
-
-                if (class_clear != class_enc)
-                {
-                    count_disagreements++;
-                    if (failed_bs)
-                        count_disagreements_with_failed_bs++;
-
-                    if (class_clear == label)
-                        count_disag_pro_clear++;
-                    else if (class_enc == label)
-                        count_disag_pro_hom++;
-                }
-                net_end = clock();
-                time_per_classification = net_end - net_begin;
-                total_time_network += time_per_classification;
-                // if (VERBOSE) cout << "            "<< time_per_classification*clocks2seconds <<" [sec/classification]" << endl;
-
-                enc_imgae_1.clear();
-                bootstrapped_1.clear();
-                multi_sum_1.clear();
-
-                cout<<"Process "<<id_proc<<"  image "<< img <<" output the result :"<<"\n";
-                cout<<"the label of digit is "<<label<<endl;
-                cout<<"the recognition result without fhe is "<< class_clear<<endl;
-                cout<<"the recognition result using fhe is "<<class_enc<<endl;
-                cout<<"-----------------------------------------------------------------------------------------"<<endl;        
-
+                max_score = score;
+                class_enc = j;
+            }
+            if (clear_out[j] > max_score_clear)
+            {
+                max_score_clear = clear_out[j];
+                class_clear = j;
             }
-            // for (int img = id_proc*slice; img < ( (id_proc+1)*slice) && (img< n_images); /*img*/ )
-            FILE* stream = fdopen(pipes[id_proc][1], "w");
-            fprintf(stream, "%d,%d,%d,%d,%d,%d,%d,%lf,%lf\n", count_errors, count_disagreements, count_disag_pro_clear, count_disag_pro_hom, count_wrong_bs,
-                    count_errors_with_failed_bs, count_disagreements_with_failed_bs, total_time_network, total_time_bootstrappings);
-            fclose(stream);
-            exit(0);
         }
-    }
+        timer.Stop();
 
-    for (auto pid : pids)
-    {
-        waitpid(pid, 0, 0);
-    }
+        if (class_enc != label)
+        {
+            count_errors++;
+            if (failed_bs)
+                count_errors_with_failed_bs++;
+        }
 
-    end = time(NULL);
-    double total_time = (end - begin);
-    // double avg_time = (total_time*clocks2seconds)/n_images; 
+        if (class_clear != class_enc)
+        {
+            count_disagreements++;
+            if (failed_bs)
+                count_disagreements_with_failed_bs++;
+
+            if (class_clear == label)
+                count_disag_pro_clear++;
+            else if (class_enc == label)
+                count_disag_pro_hom++;
+        }
 
+        cout<<"Image "<< img+1 <<" output the result :"<<"\n";
+        cout<<"the label of digit is "<<label<<endl;
+        cout<<"the recognition result without fhe is "<< class_clear<<endl;
+        cout<<"the recognition result using fhe is "<<class_enc<<endl;
+        cout<<"-----------------------------------------------------------------------------------------"<<endl;
+    };
 
-    time_per_classification = 0.0;
-    time_per_bootstrapping = 0.0;
-    for (int id_proc=0; id_proc<N_PROC; ++id_proc)
-    {
-        FILE* stream = fdopen(pipes[id_proc][0], "r");
-        fscanf(stream, "%d,%d,%d,%d,%d,%d,%d,%lf,%lf\n", &r_count_errors, &r_count_disagreements,
-               &r_count_disag_pro_clear, &r_count_disag_pro_hom, &r_count_wrong_bs, &r_count_errors_with_failed_bs,
-               &r_count_disagreements_with_failed_bs, &r_total_time_network, &r_total_time_bootstrappings);
-        fclose(stream);
-        count_errors += r_count_errors;
-        count_disagreements += r_count_disagreements;
-        count_disag_pro_clear += r_count_disag_pro_clear;
-        count_disag_pro_hom += r_count_disag_pro_hom;
-        count_wrong_bs += r_count_wrong_bs;
-        count_errors_with_failed_bs += r_count_errors_with_failed_bs;
-        count_disagreements_with_failed_bs += r_count_disagreements_with_failed_bs;
-        time_per_classification += r_total_time_network;
-        time_per_bootstrapping += r_total_time_bootstrappings;
-    }
+    if (VERBOSE) cout << "Classifying " << n_images << " images with " << engine.GetNumThreads() << " threads" << endl;
+
+    StageProfiler::Enable(PROFILE_STAGES);
 
+    TimeVar t_total;
+    TIC(t_total);
+    engine.RunPipeline(encrypt_image, score_image, QUEUE_DEPTH);
+    double total_time = TOC_MS(t_total) / 1000.;
 
 
+    // For statistics output
+    double error_rel_percent = count_errors*avg_img*100;
+    // wall-clock times, the linear layers are included in the bootstrapping time;
+    // with the pipeline they also include the client-side encryption of the
+    // first image and decryption of the last one
+    double avg_time_per_classification = total_time*avg_img;
+    double avg_time_per_bootstrapping  = total_time*avg_total_bs;
+
     if (statistics)
     {
         ofstream of(FILE_STATISTICS);
         // Print some statistics
-        error_rel_percent = count_errors*avg_img*100;
-        avg_time_per_classification = time_per_classification*avg_img*clocks2seconds;
-        avg_time_per_bootstrapping  = time_per_bootstrapping *avg_total_bs *clocks2seconds;
-
         cout<<"The recognition process is completed, total "<<n_images<<"digits have been recogized "<<endl;
         cout << "Recognition errors: " << count_errors << " / " << n_images << " (" << error_rel_percent << " %)" << endl;
         cout << "Disagreements: " << count_disagreements<<endl;
-        // cout << " (pro-clear/pro-hom: " << count_disag_pro_clear << " / " << count_disag_pro_hom << ")" << endl;
-        // cout << "Wrong bootstrappings: " << count_wrong_bs << endl;
-        // cout << "Errors with failed bootstrapping: " << count_errors_with_failed_bs << endl;
-        // cout << "Disagreements with failed bootstrapping: " << count_disagreements_with_failed_bs << endl;
-        cout << "Average time for the evaluation of each digit (seconds): " << total_time/n_images << endl;
-        // cout<<"total CPU time is "<<total_time<<"   "<<begin<<"        "<<end<<endl;
-        // cout << "Avg. time per bootstrapping (seconds): " << avg_time << endl;
-
-        // of << "Errors: " << count_errors << " / " << n_images << " (" << error_rel_percent << " %)" << endl;
-        // of << "Disagreements: " << count_disagreements;
-        // of << " (pro-clear/pro-hom: " << count_disag_pro_clear << " / " << count_disag_pro_hom << ")" << endl;
-        // of << "Wrong bootstrappings: " << count_wrong_bs << endl;
-        // of << "Errors with failed bootstrapping: " << count_errors_with_failed_bs << endl;
-        // of << "Disagreements with failed bootstrapping: " << count_disagreements_with_failed_bs << endl;
-        // of << "Avg. time for the evaluation of the network (seconds): " << avg_time_per_classification << endl;
-        // of << "Avg. time per bootstrapping (seconds): " << avg_time_per_bootstrapping << endl;
+        cout << "Average time for the evaluation of each digit (seconds): " << avg_time_per_classification << endl;
+
+        of << "Errors: " << count_errors << " / " << n_images << " (" << error_rel_percent << " %)" << endl;
+        of << "Disagreements: " << count_disagreements;
+        of << " (pro-clear/pro-hom: " << count_disag_pro_clear << " / " << count_disag_pro_hom << ")" << endl;
+        of << "Avg. time for the evaluation of the network (seconds): " << avg_time_per_classification << endl;
 
         // Write some statistics
         cout << "\n Wrote statistics to file: " << FILE_STATISTICS << endl << endl;
         of.close();
     }
 
+    if (PROFILE_STAGES)
+    {
+        cout << "Latency of the stages:" << endl;
+        StageProfiler::Print(cout);
+        ofstream of(FILE_PROFILE);
+        StageProfiler::PrintJSON(of);
+        cout << "\n Wrote the stage latencies to file: " << FILE_PROFILE << endl << endl;
+    }
+
     if (writeLaTeX_result)
     {
         cout << "\n Wrote LaTeX_result to file: " << FILE_LATEX << endl << endl;
@@ -643,42 +364,6 @@ int main(int argc, char **argv)
         of.close();
     }
 
-    // free memory
-    // delete_gate_bootstrapping_secret_keyset(secret);
-    // delete_gate_bootstrapping_parameters(params);
-
-    deleteTensor(weights,num_wire_layers, topology);
-    deleteMatrix(biases, num_wire_layers);
-    deleteMatrix(images, n_images);
-    delete[] labels;
-
     return 0;
 
 }
-
-
-
-void deleteTensor(int*** tensor, int dim_tensor, const int* dim_vec)
-{
-    int** matrix;
-    int dim_mat;
-    for (int i=0; i<dim_tensor; ++i)
-    {
-        matrix =  tensor[i];
-        dim_mat = dim_vec[i];
-        deleteMatrix(matrix, dim_mat);
-    }
-    delete[] tensor;
-}
-
-
-void deleteMatrix(int** matrix, int dim_mat)
-{
-    for (int i=0; i<dim_mat; ++i)
-    {
-        delete[] matrix[i];
-    }
-    delete[] matrix;
-}
-
-
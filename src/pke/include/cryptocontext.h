@@ -24,6 +24,7 @@
 #ifndef SRC_PKE_CRYPTOCONTEXT_H_
 #define SRC_PKE_CRYPTOCONTEXT_H_
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -38,7 +39,9 @@
 #include "utils/caller_info.h"
 #include "utils/serial.h"
 
+#include "bincircuit.h"
 #include "fhew.h"
+#include "keystream.h"
 #include "lwe.h"
 #include "ringcore.h"
 
@@ -100,7 +103,6 @@ namespace lbcrypto {
     using LWEPrivateKey = std::shared_ptr<LWEPrivateKeyImpl>;
     using ConstLWEPrivateKey = const std::shared_ptr<const LWEPrivateKeyImpl>;
 
-    using LWEPlaintextModulus = uint64_t;
     //! Binfhe_end
 
 
@@ -156,9 +158,11 @@ namespace lbcrypto {
 
         std::shared_ptr <RingGSWCryptoParams> m_params;
         // Shared pointer to the underlying additive LWE scheme
-        std::shared_ptr <LWEEncryptionScheme> m_LWEscheme;
+        std::shared_ptr <LWEEncryptionScheme> m_LWEscheme =
+                std::make_shared<LWEEncryptionScheme>();
         // Shared pointer to the underlying RingGSW/RLWE scheme
-        std::shared_ptr <RingGSWAccumulatorScheme> m_RingGSWscheme;
+        std::shared_ptr <RingGSWAccumulatorScheme> m_RingGSWscheme =
+                std::make_shared<RingGSWAccumulatorScheme>();
         // Struct containing the bootstrapping keys
         RingGSWEvalKey m_BTKey;
 
@@ -327,13 +331,86 @@ namespace lbcrypto {
         /**
         * Encrypt message without noise
         */
-        LWECiphertext HESea_TraivlEncrypt(LWEPlaintext value, LWEPlaintextModulus p);
+        LWECiphertext HESea_TraivlEncrypt(LWEPlaintext value, LWEPlaintextModulus p) const;
 
         /**
             * Evaluates SignFunc
             */
         LWECiphertext HESea_MyEvalSigndFunc(ConstLWECiphertext ct, LWEPlaintextModulus p) const;
 
+        /**
+            * Evaluates SignFunc on a batch of ciphertexts, e.g., all neurons of a layer
+            * @param cts input ciphertexts
+            * @param p plaintext modulus
+            * @return the sign of each input, in the same order
+            */
+        std::vector<LWECiphertext> HESea_EvalSignBatch(const std::vector<LWECiphertext>& cts,
+                                                      LWEPlaintextModulus p) const;
+
+        /**
+            * Sets the number of threads sharing each single bootstrapping, e.g., for
+            * latency-sensitive paths that evaluate one comparison at a time
+            * @param numThreads number of threads; 0 or 1 runs it on the calling thread
+            */
+        void HESea_SetBootstrapThreads(uint32_t numThreads) {
+            m_RingGSWscheme->SetBootstrapThreads(numThreads);
+        }
+
+        /**
+            * Caps the number of threads of HESea_BTKeyGen, e.g., to stay within the
+            * limits of a container
+            * @param numThreads number of threads; 0 uses all OpenMP threads
+            */
+        void HESea_SetKeyGenThreads(uint32_t numThreads) {
+            m_RingGSWscheme->SetKeyGenThreads(numThreads);
+        }
+
+        /**
+            * Sets a function reporting the progress of HESea_BTKeyGen, called with the
+            * number of refreshing key entries generated so far and their total
+            * @param progress the function; empty for no reports
+            */
+        void HESea_SetKeyGenProgress(const RingGSWAccumulatorScheme::KeyGenProgress& progress) {
+            m_RingGSWscheme->SetKeyGenProgress(progress);
+        }
+
+        /**
+            * Evaluates a lookup table over Z_p in one bootstrapping, e.g., ReLU or
+            * clipped-linear activations. Tables other than negacyclic ones
+            * (LUT[m + p/2] = -LUT[m]) require the input to lie in [0, p/2).
+            * The test vector of each table is generated once and cached.
+            * @param ct input ciphertext
+            * @param LUT the table; LUT[m] is the output for the message m
+            * @param p plaintext modulus of the input and the output
+            * @return the encryption of LUT[m]
+            */
+        LWECiphertext HESea_EvalFunc(ConstLWECiphertext ct, const std::vector<LWEPlaintext>& LUT,
+                                     LWEPlaintextModulus p) const;
+
+        /**
+            * Evaluates several lookup tables over Z_p on the same input with one
+            * bootstrapping, e.g., the sign and a clipped value of a neuron. Each
+            * further table costs a key switching instead of a bootstrapping; the
+            * noise grows with the jumps between consecutive table entries, so the
+            * tables should be small or smooth. The input range is as for HESea_EvalFunc.
+            * @param ct input ciphertext
+            * @param LUTs the tables; LUTs[k][m] is the output k for the message m
+            * @param p plaintext modulus of the input and the outputs
+            * @return the encryption of LUTs[k][m] for each table, in the same order
+            */
+        std::vector<LWECiphertext> HESea_EvalMultiFunc(ConstLWECiphertext ct,
+                                                       const std::vector<std::vector<LWEPlaintext>>& LUTs,
+                                                       LWEPlaintextModulus p) const;
+
+        /**
+            * Tabulates a function over Z_p for HESea_EvalFunc
+            * @param f the function; its result is reduced modulo p
+            * @param p plaintext modulus
+            * @return the table f(0), ..., f(p-1)
+            */
+        static std::vector<LWEPlaintext> HESea_GenerateLUTviaFunction(
+                const std::function<LWEPlaintext(LWEPlaintext)>& f, LWEPlaintextModulus p);
+
         /**
             * Encrypt message with modulus p
         
@@ -415,6 +492,30 @@ namespace lbcrypto {
         LWECiphertext HESea_EvalBinGate(const BINGATE gate, ConstLWECiphertext ct1,
                                   ConstLWECiphertext ct2) const;
 
+        /**
+          * Evaluates a gate of two or three inputs with a single bootstrapping
+          *
+          * @param gate the gate; MAJORITY, AND3 and OR3 take three inputs, and the
+          * inputs of AND3 and OR3 must be encrypted with plaintext modulus 6
+          * @param cts the input ciphertexts
+          * @return a shared pointer to the resulting ciphertext
+          */
+        LWECiphertext HESea_EvalBinGate(const BINGATE gate,
+                                  const std::vector<std::shared_ptr<const LWECiphertextImpl>>& cts) const;
+
+        /**
+          * Evaluates a threshold gate, which is 1 if at least threshold of the
+          * inputs are 1, with a single bootstrapping
+          *
+          * @param cts the input ciphertexts, encrypted with plaintext modulus p
+          * @param threshold number of inputs that have to be 1
+          * @param p plaintext modulus of the inputs; twice the number of inputs
+          * works for every threshold
+          * @return a shared pointer to the resulting ciphertext
+          */
+        LWECiphertext HESea_EvalThresholdGate(const std::vector<std::shared_ptr<const LWECiphertextImpl>>& cts,
+                                  uint32_t threshold, LWEPlaintextModulus p) const;
+
         /**
          * Evaluates constant gate
          *
@@ -431,6 +532,17 @@ namespace lbcrypto {
          */
         LWECiphertext HESea_EvalNOT(ConstLWECiphertext ct1) const;
 
+        /**
+         * Evaluates a Boolean circuit; the bootstrapped gates of each level
+         * of the circuit are evaluated in parallel
+         *
+         * @param circuit the circuit
+         * @param inputs a ciphertext for each input of the circuit
+         * @return a ciphertext for each output of the circuit
+         */
+        std::vector<LWECiphertext> HESea_EvalCircuit(const BinFHECircuit& circuit,
+                                  const std::vector<std::shared_ptr<const LWECiphertextImpl>>& inputs) const;
+
         /**
          * Creates a crypto context using predefined parameters sets. Recommended for
          * most users.
@@ -465,12 +577,12 @@ namespace lbcrypto {
                                    BINFHEMETHOD method = GINX);
 
 
-        const std::shared_ptr <LWEEncryptionScheme> HESea_GetLWEScheme() {
+        const std::shared_ptr <LWEEncryptionScheme> HESea_GetLWEScheme() const {
             return m_LWEscheme;
         }
 
 
-        const std::shared_ptr <RingGSWCryptoParams> HESea_GetParams() { return m_params; }
+        const std::shared_ptr <RingGSWCryptoParams> HESea_GetParams() const { return m_params; }
 
         /**
          * Gets the refreshing key (used for serialization).
@@ -481,7 +593,7 @@ namespace lbcrypto {
             return m_BTKey.BSkey;
         }
 
-        const std::shared_ptr <RingGSWAccumulatorScheme> HESea_GetRingGSWScheme() {
+        const std::shared_ptr <RingGSWAccumulatorScheme> HESea_GetRingGSWScheme() const {
             return m_RingGSWscheme;
         }
 
@@ -0,0 +1,107 @@
+// @file dinnengine.h -- Inference engine for encrypted discretized neural networks.
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SRC_PKE_DINNENGINE_H_
+#define SRC_PKE_DINNENGINE_H_
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "cryptocontext.h"
+#include "dinnmodel.h"
+
+namespace lbcrypto {
+
+/**
+ * @brief Runs an encrypted discretized neural network (DiNN) on many images.
+ *
+ * All worker threads share the bootstrapping key of the crypto context and
+ * one copy of the model. Images are handed out to the workers one at a time,
+ * so a slow image does not hold back a whole statically assigned slice.
+ *
+ * Run takes a batch of encrypted images. RunPipeline instead overlaps the
+ * encryption of the next images and the scoring of the previous ones with
+ * the evaluation, and only keeps a bounded number of images in memory.
+ */
+template <typename Element>
+class DiNNInferenceEngine {
+ public:
+  /**
+   * Constructor
+   *
+   * @param model network to evaluate; its crypto context must already have
+   * the bootstrapping keys
+   * @param numThreads number of worker threads; 0 uses all available threads
+   */
+  explicit DiNNInferenceEngine(
+      std::shared_ptr<const EncryptedDiscretizedNet<Element>> model,
+      uint32_t numThreads = 0);
+
+  /**
+   * Classifies a set of encrypted images
+   *
+   * @param images images[k][i] encrypts pixel i of image k
+   * @return the encrypted scores of the output layer for each image
+   */
+  std::vector<std::vector<LWECiphertext>> Run(
+      const std::vector<std::vector<LWECiphertext>> &images) const;
+
+  /**
+   * Classifies a stream of images in a three-stage pipeline: an encryption
+   * thread, the worker threads and a scoring thread, connected by two
+   * bounded queues. The encryption and scoring threads are in addition to
+   * the worker threads.
+   *
+   * @param encrypt called by the encryption thread with the index of the
+   * next image; stores its encrypted pixels and returns false when there are
+   * no more images
+   * @param score called by the scoring thread with the index and the
+   * encrypted output scores of each image, in the order they complete
+   * @param queueDepth capacity of each queue
+   * @return the number of classified images
+   */
+  size_t RunPipeline(
+      const std::function<bool(size_t, std::vector<LWECiphertext> *)> &encrypt,
+      const std::function<void(size_t, const std::vector<LWECiphertext> &)>
+          &score,
+      uint32_t queueDepth = 4) const;
+
+  const std::shared_ptr<const EncryptedDiscretizedNet<Element>> GetModel()
+      const {
+    return m_model;
+  }
+
+  uint32_t GetNumThreads() const { return m_numThreads; }
+
+ private:
+  // throws if the bootstrapping keys are missing
+  void CheckKeys() const;
+
+  std::shared_ptr<const EncryptedDiscretizedNet<Element>> m_model;
+  uint32_t m_numThreads;
+};
+
+}  // namespace lbcrypto
+
+#endif
@@ -0,0 +1,181 @@
+// @file dinnfile.h -- Binary container for DiNN models and test sets.
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SRC_PKE_DINNFILE_H_
+#define SRC_PKE_DINNFILE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lbcrypto {
+
+/**
+ * @brief Read-only view of a binary DiNN container. The file is memory
+ * mapped, so every worker that opens the same file shares its pages.
+ *
+ * Layout (little endian, every section aligned to 8 bytes):
+ *   header      DiNNFileHeader
+ *   shape       numDims x uint32
+ *   MODEL:      for each layer l: weights (shape[l] x shape[l+1], by input
+ *               neuron, as in the text files), then biases (shape[l+1])
+ *   DATASET:    labels (shape[0]), then pixels (shape[0] x shape[1])
+ * All values are signed integers of the width given by the dtype.
+ */
+class DiNNFile {
+ public:
+  enum Kind : uint32_t { MODEL = 0, DATASET = 1 };
+
+  enum DType : uint32_t { INT8 = 1, INT16 = 2, INT32 = 4, INT64 = 8 };
+
+  static const uint32_t VERSION = 1;
+
+  struct DiNNFileHeader {
+    char magic[4];  // "DiNN"
+    uint32_t version;
+    uint32_t kind;
+    uint32_t dtype;
+    // plaintext modulus the values are meant for; 0 if unspecified
+    uint64_t modulus;
+    uint32_t numDims;
+    uint32_t reserved;
+  };
+
+  /**
+   * Maps a container file
+   *
+   * @param path file name
+   */
+  explicit DiNNFile(const std::string &path);
+
+  ~DiNNFile();
+
+  DiNNFile(const DiNNFile &) = delete;
+  DiNNFile &operator=(const DiNNFile &) = delete;
+
+  Kind GetKind() const { return static_cast<Kind>(m_header->kind); }
+
+  DType GetDType() const { return static_cast<DType>(m_header->dtype); }
+
+  uint32_t GetVersion() const { return m_header->version; }
+
+  uint64_t GetModulus() const { return m_header->modulus; }
+
+  /**
+   * @return the topology of a model, or {number of images, image size} of
+   * a dataset
+   */
+  const std::vector<uint32_t> &GetShape() const { return m_shape; }
+
+  /**
+   * @param l layer index
+   * @return weights of layer l, by input neuron
+   */
+  std::vector<int64_t> GetWeights(uint32_t l) const;
+
+  /**
+   * @param l layer index
+   * @return biases of layer l
+   */
+  std::vector<int64_t> GetBiases(uint32_t l) const;
+
+  uint32_t GetNumImages() const;
+
+  uint32_t GetImageSize() const;
+
+  /**
+   * @param k image index
+   * @return pixels of image k
+   */
+  std::vector<int64_t> GetImage(uint32_t k) const;
+
+  /**
+   * @param k image index
+   * @return label of image k
+   */
+  int64_t GetLabel(uint32_t k) const;
+
+  /**
+   * Writes a model container
+   *
+   * @param path file name
+   * @param topology number of neurons of each layer, the input layer first
+   * @param weights weights[l] of layer l, by input neuron
+   * @param biases biases[l] of layer l
+   * @param modulus plaintext modulus, 0 if unspecified
+   */
+  static void WriteModel(const std::string &path,
+                         const std::vector<uint32_t> &topology,
+                         const std::vector<std::vector<int64_t>> &weights,
+                         const std::vector<std::vector<int64_t>> &biases,
+                         uint64_t modulus = 0);
+
+  /**
+   * Writes a dataset container
+   *
+   * @param path file name
+   * @param images images of the same size
+   * @param labels one label per image
+   */
+  static void WriteDataset(const std::string &path,
+                           const std::vector<std::vector<int64_t>> &images,
+                           const std::vector<int64_t> &labels);
+
+  /**
+   * Converts the text files of a model (one value per line) to a container
+   */
+  static void ConvertModelText(const std::string &weightsTxt,
+                               const std::string &biasesTxt,
+                               const std::vector<uint32_t> &topology,
+                               const std::string &path, uint64_t modulus = 0);
+
+  /**
+   * Converts the text files of a test set (one value per line) to a
+   * container
+   */
+  static void ConvertDatasetText(const std::string &imagesTxt,
+                                 const std::string &labelsTxt,
+                                 uint32_t numImages, uint32_t imageSize,
+                                 const std::string &path);
+
+ private:
+  // reads count values of the file dtype starting at byte offset
+  std::vector<int64_t> Read(size_t offset, size_t count) const;
+
+  void Unmap();
+
+  const uint8_t *m_data = nullptr;
+  size_t m_size = 0;
+  const DiNNFileHeader *m_header = nullptr;
+  std::vector<uint32_t> m_shape;
+  // byte offset of the first value
+  size_t m_payload = 0;
+#if defined(_WIN32)
+  // no mmap on Windows, the file is read into memory
+  std::vector<char> m_buffer;
+#endif
+};
+
+}  // namespace lbcrypto
+
+#endif
@@ -0,0 +1,131 @@
+// @file dinnmodel.h -- Discretized neural network evaluated on LWE ciphertexts.
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef SRC_PKE_DINNMODEL_H_
+#define SRC_PKE_DINNMODEL_H_
+
+#include <memory>
+#include <vector>
+
+#include "cryptocontext.h"
+#include "dinnfile.h"
+
+namespace lbcrypto {
+
+/**
+ * @brief Discretized neural network (DiNN) with an arbitrary number of layers
+ * of arbitrary width, evaluated on LWE-encrypted inputs. Hidden neurons are
+ * refreshed by the sign bootstrapping, the output layer is a plain linear
+ * combination that is returned encrypted.
+ *
+ * The weights of each layer are kept in one contiguous block, row j holding
+ * all weights into output neuron j, so that the weighted sum of a neuron
+ * walks memory linearly. They are reduced mod q once when the model is built,
+ * and the biases are stored as trivial LWE encryptions.
+ */
+template <typename Element>
+class EncryptedDiscretizedNet {
+ public:
+  /**
+   * Constructor
+   *
+   * @param cc crypto context used for the evaluation
+   * @param topology number of neurons of each layer, the input layer first
+   * @param weights weights[l][i*topology[l+1] + j] connects neuron i of layer
+   * l to neuron j of layer l+1, i.e., the order of the weights file
+   * @param biases biases[l][j] is the bias of neuron j of layer l+1
+   * @param p plaintext modulus
+   */
+  EncryptedDiscretizedNet(const CryptoContextImpl<Element> &cc,
+                          const std::vector<uint32_t> &topology,
+                          const std::vector<std::vector<int64_t>> &weights,
+                          const std::vector<std::vector<int64_t>> &biases,
+                          LWEPlaintextModulus p);
+
+  /**
+   * Constructor from a model container
+   *
+   * @param cc crypto context used for the evaluation
+   * @param file mapped model file
+   * @param p plaintext modulus; has to match the file if it records one
+   */
+  EncryptedDiscretizedNet(const CryptoContextImpl<Element> &cc,
+                          const DiNNFile &file, LWEPlaintextModulus p);
+
+  /**
+   * Evaluates the network on one encrypted image
+   *
+   * @param image encrypted pixels
+   * @return the encrypted scores of the output layer
+   */
+  std::vector<LWECiphertext> Infer(
+      const std::vector<LWECiphertext> &image) const;
+
+  /**
+   * Evaluates the network on several encrypted images; the hidden neurons of
+   * all images of a layer are bootstrapped in a single batch
+   *
+   * @param images images[k][i] encrypts pixel i of image k
+   * @return the encrypted scores of the output layer for each image
+   */
+  std::vector<std::vector<LWECiphertext>> InferBatch(
+      const std::vector<std::vector<LWECiphertext>> &images) const;
+
+  /**
+   * Evaluates the network in the clear, e.g., to check the encrypted result
+   *
+   * @param image pixels
+   * @return the scores of the output layer
+   */
+  std::vector<int64_t> InferClear(const std::vector<int64_t> &image) const;
+
+  const CryptoContextImpl<Element> &GetCryptoContext() const { return m_cc; }
+
+  const std::vector<uint32_t> &GetTopology() const { return m_topology; }
+
+  LWEPlaintextModulus GetPlaintextModulus() const { return m_p; }
+
+ private:
+  static std::vector<std::vector<int64_t>> ReadWeights(const DiNNFile &file);
+
+  static std::vector<std::vector<int64_t>> ReadBiases(const DiNNFile &file);
+
+  // encrypted linear layer l: bias plus the weighted sum of the inputs
+  std::vector<LWECiphertext> EvalLinear(
+      uint32_t l, const std::vector<LWECiphertext> &in) const;
+
+  const CryptoContextImpl<Element> &m_cc;
+  std::vector<uint32_t> m_topology;
+  // signed weights of each layer, row j holds the weights into neuron j
+  std::vector<std::vector<int64_t>> m_weights;
+  // the same weights reduced mod q
+  std::vector<NativeVector> m_weightsModq;
+  std::vector<std::vector<int64_t>> m_biases;
+  // biases encoded as trivial encryptions
+  std::vector<std::vector<LWECiphertextImpl>> m_biasesEnc;
+  LWEPlaintextModulus m_p;
+};
+
+}  // namespace lbcrypto
+
+#endif
@@ -0,0 +1,181 @@
+// @file dinnqueue.h -- Bounded lock-free queue between the DiNN pipeline stages.
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+
+#ifndef SRC_PKE_DINNQUEUE_H_
+#define SRC_PKE_DINNQUEUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace lbcrypto {
+
+/**
+ * @brief Bounded multi-producer multi-consumer queue.
+ *
+ * Each slot carries a sequence number that tells producers and consumers
+ * whose turn it is, so pushing and popping only take an atomic compare and
+ * swap on the head or the tail. Push and Pop wait while the queue is full or
+ * empty; after Close, Push fails and Pop drains the remaining elements.
+ */
+template <typename T>
+class BoundedQueue {
+ public:
+  /**
+   * Constructor
+   *
+   * @param capacity maximum number of queued elements, rounded up to a power
+   * of two and at least 2
+   */
+  explicit BoundedQueue(size_t capacity) : m_closed(false) {
+    // with a single slot, a producer could not tell a popped slot from one
+    // that is still full
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    m_mask = size - 1;
+    m_cells.reset(new Cell[size]);
+    for (size_t i = 0; i < size; i++)
+      m_cells[i].seq.store(i, std::memory_order_relaxed);
+    m_head.store(0, std::memory_order_relaxed);
+    m_tail.store(0, std::memory_order_relaxed);
+  }
+
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  size_t GetCapacity() const { return m_mask + 1; }
+
+  /**
+   * Adds an element if the queue is not full
+   *
+   * @return false if the queue is full
+   */
+  bool TryPush(T &&value) {
+    size_t pos = m_tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = m_cells[pos & m_mask];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (m_tail.compare_exchange_weak(pos, pos + 1,
+                                         std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Removes the oldest element if the queue is not empty
+   *
+   * @return false if the queue is empty
+   */
+  bool TryPop(T *value) {
+    size_t pos = m_head.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = m_cells[pos & m_mask];
+      size_t seq = cell.seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (m_head.compare_exchange_weak(pos, pos + 1,
+                                         std::memory_order_relaxed)) {
+          *value = std::move(cell.value);
+          cell.seq.store(pos + m_mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = m_head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Adds an element, waiting while the queue is full
+   *
+   * @return false if the queue was closed
+   */
+  bool Push(T &&value) {
+    for (uint32_t spins = 0;; spins++) {
+      if (m_closed.load(std::memory_order_acquire)) return false;
+      if (TryPush(std::move(value))) return true;
+      Backoff(spins);
+    }
+  }
+
+  /**
+   * Removes the oldest element, waiting while the queue is empty
+   *
+   * @return false if the queue was closed and is empty
+   */
+  bool Pop(T *value) {
+    for (uint32_t spins = 0;; spins++) {
+      if (TryPop(value)) return true;
+      // elements pushed before Close are still seen by this second attempt
+      if (m_closed.load(std::memory_order_acquire)) return TryPop(value);
+      Backoff(spins);
+    }
+  }
+
+  /**
+   * Wakes up all waiting producers and consumers; no element can be added
+   * afterwards
+   */
+  void Close() { m_closed.store(true, std::memory_order_release); }
+
+  bool IsClosed() const { return m_closed.load(std::memory_order_acquire); }
+
+ private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  // the stages of the pipeline take milliseconds, so a waiting thread soon
+  // sleeps instead of taking the core from the thread it is waiting for
+  static void Backoff(uint32_t spins) {
+    if (spins < 64)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+
+  std::unique_ptr<Cell[]> m_cells;
+  size_t m_mask;
+  // head and tail on separate cache lines
+  alignas(64) std::atomic<size_t> m_head;
+  alignas(64) std::atomic<size_t> m_tail;
+  std::atomic<bool> m_closed;
+};
+
+}  // namespace lbcrypto
+
+#endif
@@ -51,7 +51,7 @@ namespace lbcrypto {
     }
 
     template<typename Element>
-    LWECiphertext CryptoContextImpl<Element>::HESea_TraivlEncrypt(LWEPlaintext value, LWEPlaintextModulus p){
+    LWECiphertext CryptoContextImpl<Element>::HESea_TraivlEncrypt(LWEPlaintext value, LWEPlaintextModulus p) const {
         NativeInteger q = m_params->GetLWEParams()->Getq();
         uint32_t n = m_params->GetLWEParams()->Getn();
 
@@ -134,104 +134,39 @@ namespace lbcrypto {
 
     template<typename Element>
     LWECiphertext CryptoContextImpl<Element>::HESea_MyEvalSigndFunc(ConstLWECiphertext ct, LWEPlaintextModulus p) const {
-        auto ek = m_BTKey.BSkey;
-        if (ek == nullptr) {
-            std::string errMsg =
-                "Bootstrapping keys have not been generated. Please call BTKeyGen before calling bootstrapping.";
-            PALISADE_THROW(config_error, errMsg);
-        }
-
-        auto& LWEParams  = m_params->GetLWEParams();
-        auto& RGSWParams = m_params;
-        auto polyParams  = RGSWParams->GetPolyParams();
-
-        NativeInteger Q = LWEParams->GetQ();
-        NativeInteger q = LWEParams->Getq();
-        uint32_t N      = LWEParams->GetN();
-        uint32_t n      = LWEParams->Getn();
-        NativeVector m(N, Q);
-
-        auto ct1 = m_LWEscheme->ModSwitch(NativeInteger(2*N), ct);
-
-        // For specific function evaluation instead of generalbootstrapping
-        NativeInteger ctMod    = ct1->GetA().GetModulus(); //q
-        const NativeInteger& b = ct1->GetB();
-        const NativeVector&  a = ct1->GetA();
-        for (size_t j = 0; j < (ctMod >> 1 ); ++j) {  //q/2
-            NativeInteger temp = b.ModSub(j, ctMod);
-            m[j] = (temp%ctMod <= ctMod/2)?  Q/p : (p-1)*Q/p;        
-        }
-        std::vector<NativePoly> res(2);
-        // no need to do NTT as all coefficients of this poly are zero
-        res[0] = NativePoly(polyParams, Format::EVALUATION, true);
-        res[1] = NativePoly(polyParams, Format::COEFFICIENT, false);
-        res[1].SetValues(std::move(m), Format::COEFFICIENT);
-        res[1].SetFormat(Format::EVALUATION);
-
-        // main accumulation computation
-        // the following loop is the bottleneck of bootstrapping/binary gate
-        // evaluation
-        auto acc = std::make_shared<RingGSWCiphertext>(1, 2);
-        vector<vector<NativePoly>> res1;
-        res1.push_back(res);
-        acc->SetElements(std::move(res1));
-        // (*acc)[0] = std::move(res);
-
-        auto digitsR = m_params->GetDigitsR();
-        auto baseR = m_params->GetBaseR();
-
-
-        if (m_params->GetMethod() == AP) {
-            for (uint32_t i = 0; i < n; i++) {
-            NativeInteger aI = ctMod.ModSub(a[i], ctMod);
-            for (uint32_t k = 0; k < digitsR.size();
-                k++, aI /= NativeInteger(baseR)) {
-                uint32_t a0 = (aI.Mod(baseR)).ConvertToInt();
-                if (a0) m_RingGSWscheme->AddToACCAP(m_params, (*ek)[i][a0][k], acc);
-            }
-            }
-        } else {  // if GINX
-            for (uint32_t i = 0; i < n; i++) {
-            // handles -a*E(1) and handles -a*E(-1) = a*E(1)
-            m_RingGSWscheme->AddToACCGINX(m_params, (*ek)[0][0][i], (*ek)[0][1][i], ctMod.ModSub(a[i], ctMod), acc);
-            // m_RingGSWscheme->AddToACCGINX(m_params, (*ek)[0][0][i], (*ek)[0][1][i], a[i].Mod(ctMod), acc);
-            
-            }
-        }
-        
-        NativePoly temp = (*acc)[0][0];
-        temp = temp.Transpose();
-        temp.SetFormat(Format::COEFFICIENT);
-        auto aNew = temp.GetValues();
-
-        temp = (*acc)[0][1];
-        temp.SetFormat(Format::COEFFICIENT);
-        // we add Q/8 to "b" to to map back to Q/4 (i.e., mod 2) arithmetic.
-        auto bNew = temp[0];
-
-        // Modulus switching to a middle step Q'
-        auto eQN = m_LWEscheme->ModSwitch(m_params->GetLWEParams()->GetqKS(), std::make_shared<LWECiphertextImpl>(aNew, bNew));
-        
-        
-        // std::vector<NativePoly>& accVec = (*acc)[0];
-        // // the accumulator result is encrypted w.r.t. the transposed secret key
-        // // we can transpose "a" to get an encryption under the original secret key
-        // accVec[0] = accVec[0].Transpose();
-        // accVec[0].SetFormat(Format::COEFFICIENT);
-        // accVec[1].SetFormat(Format::COEFFICIENT);
-
+        return m_RingGSWscheme->EvalSign(m_params, m_BTKey, ct, p, m_LWEscheme);
+    }
 
-        // auto ctExt      = std::make_shared<LWECiphertextImpl>(std::move(accVec[0].GetValues()), std::move(accVec[1][0]));
-        // Modulus switching to a middle step qKS'
-        // Modulus switching
+    template<typename Element>
+    std::vector<LWECiphertext> CryptoContextImpl<Element>::HESea_EvalSignBatch(const std::vector<LWECiphertext>& cts,
+                                                                              LWEPlaintextModulus p) const {
+        return m_RingGSWscheme->EvalSignBatch(m_params, m_BTKey, cts, p, m_LWEscheme);
+    }
 
+    template<typename Element>
+    LWECiphertext CryptoContextImpl<Element>::HESea_EvalFunc(ConstLWECiphertext ct,
+                                                            const std::vector<LWEPlaintext>& LUT,
+                                                            LWEPlaintextModulus p) const {
+        return m_RingGSWscheme->EvalFunc(m_params, m_BTKey, ct, LUT, p, m_LWEscheme);
+    }
 
-        auto ctMS = m_LWEscheme->ModSwitch(LWEParams->GetqKS(), eQN);
-        // Key switching
-        auto ctKS = m_LWEscheme->KeySwitch(LWEParams, m_BTKey.KSkey, ctMS);
-        // Modulus switching
-        return m_LWEscheme->ModSwitch(LWEParams->Getq(), ctKS);
+    template<typename Element>
+    std::vector<LWECiphertext> CryptoContextImpl<Element>::HESea_EvalMultiFunc(
+            ConstLWECiphertext ct, const std::vector<std::vector<LWEPlaintext>>& LUTs,
+            LWEPlaintextModulus p) const {
+        return m_RingGSWscheme->EvalMultiFunc(m_params, m_BTKey, ct, LUTs, p, m_LWEscheme);
+    }
 
+    template<typename Element>
+    std::vector<LWEPlaintext> CryptoContextImpl<Element>::HESea_GenerateLUTviaFunction(
+            const std::function<LWEPlaintext(LWEPlaintext)>& f, LWEPlaintextModulus p) {
+        std::vector<LWEPlaintext> LUT(p);
+        for (LWEPlaintextModulus m = 0; m < p; m++) {
+            LUT[m] = f(m) % (LWEPlaintext)p;
+            if (LUT[m] < 0)
+                LUT[m] += p;
+        }
+        return LUT;
     }
 
     template<typename Element>
@@ -440,6 +375,19 @@ namespace lbcrypto {
                                             m_LWEscheme);
     }
 
+    template<typename Element>
+    LWECiphertext CryptoContextImpl<Element>::HESea_EvalBinGate(const BINGATE gate,
+                                                          const std::vector<std::shared_ptr<const LWECiphertextImpl>>& cts) const {
+        return m_RingGSWscheme->EvalBinGate(m_params, gate, m_BTKey, cts, m_LWEscheme);
+    }
+
+    template<typename Element>
+    LWECiphertext CryptoContextImpl<Element>::HESea_EvalThresholdGate(const std::vector<std::shared_ptr<const LWECiphertextImpl>>& cts,
+                                                                uint32_t threshold,
+                                                                LWEPlaintextModulus p) const {
+        return m_RingGSWscheme->EvalThresholdGate(m_params, m_BTKey, cts, threshold, p, m_LWEscheme);
+    }
+
     template<typename Element>
     LWECiphertext CryptoContextImpl<Element>::HESea_Bootstrap(ConstLWECiphertext ct1) const {
         return m_RingGSWscheme->Bootstrap(m_params, m_BTKey, ct1, m_LWEscheme);
@@ -450,6 +398,12 @@ namespace lbcrypto {
         return m_RingGSWscheme->EvalNOT(m_params, ct);
     }
 
+    template<typename Element>
+    std::vector<LWECiphertext> CryptoContextImpl<Element>::HESea_EvalCircuit(const BinFHECircuit& circuit,
+                                                                            const std::vector<std::shared_ptr<const LWECiphertextImpl>>& inputs) const {
+        return circuit.Evaluate(m_params, m_BTKey, *m_RingGSWscheme, m_LWEscheme, inputs);
+    }
+
     template<typename Element>
     LWECiphertext CryptoContextImpl<Element>::HESea_EvalConstant(bool value) const {
         return m_LWEscheme->NoiselessEmbedding(m_params->GetLWEParams(), value);
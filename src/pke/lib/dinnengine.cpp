@@ -0,0 +1,157 @@
+// @file dinnengine.cpp - inference engine for encrypted discretized neural
+// networks
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dinnengine.h"
+
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "dinnqueue.h"
+#include "utils/parallel.h"
+#include "utils/stageprofiler.h"
+
+namespace lbcrypto {
+
+template <typename Element>
+DiNNInferenceEngine<Element>::DiNNInferenceEngine(
+    std::shared_ptr<const EncryptedDiscretizedNet<Element>> model,
+    uint32_t numThreads)
+    : m_model(model) {
+#ifdef PARALLEL
+  m_numThreads = (numThreads == 0) ? omp_get_max_threads() : numThreads;
+#else
+  m_numThreads = 1;
+#endif
+}
+
+template <typename Element>
+void DiNNInferenceEngine<Element>::CheckKeys() const {
+  const auto &cc = m_model->GetCryptoContext();
+  if (cc.HESea_GetRefreshKey() == nullptr ||
+      cc.HESea_GetSwitchKey() == nullptr)
+    PALISADE_THROW(config_error,
+                   "Bootstrapping keys have not been generated. Please call "
+                   "BTKeyGen before running the inference.");
+}
+
+template <typename Element>
+std::vector<std::vector<LWECiphertext>> DiNNInferenceEngine<Element>::Run(
+    const std::vector<std::vector<LWECiphertext>> &images) const {
+  CheckKeys();
+  for (const auto &image : images)
+    if (image.size() != m_model->GetTopology()[0])
+      PALISADE_THROW(config_error,
+                     "The image size does not match the input layer");
+
+  std::vector<std::vector<LWECiphertext>> result(images.size());
+
+  // images are assigned one at a time to whichever thread is free
+#pragma omp parallel for schedule(dynamic, 1) num_threads(m_numThreads)
+  for (size_t k = 0; k < images.size(); k++) {
+    StageTimer timer("dinn.evaluate");
+    result[k] = m_model->Infer(images[k]);
+  }
+
+  return result;
+}
+
+template <typename Element>
+size_t DiNNInferenceEngine<Element>::RunPipeline(
+    const std::function<bool(size_t, std::vector<LWECiphertext> *)> &encrypt,
+    const std::function<void(size_t, const std::vector<LWECiphertext> &)>
+        &score,
+    uint32_t queueDepth) const {
+  CheckKeys();
+  if (queueDepth == 0)
+    PALISADE_THROW(config_error, "The queue depth must be positive");
+
+  typedef std::pair<size_t, std::vector<LWECiphertext>> Item;
+  BoundedQueue<Item> encrypted(queueDepth);
+  BoundedQueue<Item> evaluated(queueDepth);
+
+  // the first exception of any stage closes both queues, which stops the
+  // other stages, and is rethrown once all threads are done
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto fail = [&]() {
+    std::lock_guard<std::mutex> lock(errorMutex);
+    if (!error) error = std::current_exception();
+    encrypted.Close();
+    evaluated.Close();
+  };
+
+  size_t count = 0;
+  std::thread encryptThread([&]() {
+    try {
+      for (size_t k = 0;; k++) {
+        Item item(k, std::vector<LWECiphertext>());
+        if (!encrypt(k, &item.second)) break;
+        if (!encrypted.Push(std::move(item))) break;
+      }
+      encrypted.Close();
+    } catch (...) {
+      fail();
+    }
+  });
+  std::thread scoreThread([&]() {
+    try {
+      Item item;
+      while (evaluated.Pop(&item)) {
+        score(item.first, item.second);
+        count++;
+      }
+    } catch (...) {
+      fail();
+    }
+  });
+
+#pragma omp parallel num_threads(m_numThreads)
+  {
+    try {
+      Item item;
+      while (encrypted.Pop(&item)) {
+        if (item.second.size() != m_model->GetTopology()[0])
+          PALISADE_THROW(config_error,
+                         "The image size does not match the input layer");
+        StageTimer timer("dinn.evaluate");
+        item.second = m_model->Infer(item.second);
+        timer.Stop();
+        if (!evaluated.Push(std::move(item))) break;
+      }
+    } catch (...) {
+      fail();
+    }
+  }
+  // all workers are done, so the scoring thread can drain the queue
+  evaluated.Close();
+
+  encryptThread.join();
+  scoreThread.join();
+  if (error) std::rethrow_exception(error);
+  return count;
+}
+
+}  // namespace lbcrypto
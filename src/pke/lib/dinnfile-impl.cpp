@@ -0,0 +1,373 @@
+// @file dinnfile-impl.cpp - binary container for DiNN models and test sets
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dinnfile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+#if defined(_WIN32)
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "utils/exception.h"
+
+namespace lbcrypto {
+
+static const char DINN_MAGIC[4] = {'D', 'i', 'N', 'N'};
+
+static size_t Align8(size_t offset) { return (offset + 7) & ~size_t(7); }
+
+DiNNFile::DiNNFile(const std::string &path) {
+#if defined(_WIN32)
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open())
+    PALISADE_THROW(config_error, "Cannot open DiNN file " + path);
+  m_buffer.assign(std::istreambuf_iterator<char>(in),
+                  std::istreambuf_iterator<char>());
+  m_data = reinterpret_cast<const uint8_t *>(m_buffer.data());
+  m_size = m_buffer.size();
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) PALISADE_THROW(config_error, "Cannot open DiNN file " + path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    PALISADE_THROW(config_error, "Cannot stat DiNN file " + path);
+  }
+  m_size = st.st_size;
+  if (m_size > 0) {
+    void *addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      PALISADE_THROW(config_error, "Cannot map DiNN file " + path);
+    }
+    m_data = static_cast<const uint8_t *>(addr);
+  }
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+#endif
+
+  if (m_size < sizeof(DiNNFileHeader)) {
+    Unmap();
+    PALISADE_THROW(deserialize_error, "DiNN file is too short: " + path);
+  }
+  m_header = reinterpret_cast<const DiNNFileHeader *>(m_data);
+
+  std::string err;
+  if (std::memcmp(m_header->magic, DINN_MAGIC, sizeof(DINN_MAGIC)) != 0)
+    err = "Not a DiNN file: ";
+  else if (m_header->version == 0 || m_header->version > VERSION)
+    err = "Unsupported DiNN file version: ";
+  else if (m_header->dtype != INT8 && m_header->dtype != INT16 &&
+           m_header->dtype != INT32 && m_header->dtype != INT64)
+    err = "Unsupported DiNN value type: ";
+  else if (m_header->kind == MODEL && m_header->numDims < 2)
+    err = "A DiNN model needs at least two layers: ";
+  else if (m_header->kind == DATASET && m_header->numDims != 2)
+    err = "A DiNN dataset needs two dimensions: ";
+  else if (m_header->kind != MODEL && m_header->kind != DATASET)
+    err = "Unknown DiNN file kind: ";
+  else if (m_size < sizeof(DiNNFileHeader) + 4 * size_t(m_header->numDims))
+    err = "DiNN file is too short: ";
+
+  size_t end = 0;
+  if (err.empty()) {
+    const uint32_t *shape =
+        reinterpret_cast<const uint32_t *>(m_data + sizeof(DiNNFileHeader));
+    m_shape.assign(shape, shape + m_header->numDims);
+    m_payload = Align8(sizeof(DiNNFileHeader) + 4 * m_shape.size());
+
+    size_t dt = m_header->dtype;
+    end = m_payload;
+    if (GetKind() == MODEL) {
+      for (size_t l = 0; l + 1 < m_shape.size(); l++)
+        end = Align8(Align8(end + dt * m_shape[l] * m_shape[l + 1]) +
+                     dt * m_shape[l + 1]);
+    } else {
+      end = Align8(end + dt * m_shape[0]) + dt * m_shape[0] * m_shape[1];
+    }
+    if (m_size < end) err = "DiNN file is truncated: ";
+  }
+
+  if (!err.empty()) {
+    Unmap();
+    PALISADE_THROW(deserialize_error, err + path);
+  }
+}
+
+DiNNFile::~DiNNFile() { Unmap(); }
+
+void DiNNFile::Unmap() {
+#if !defined(_WIN32)
+  if (m_data != nullptr) munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+  m_data = nullptr;
+  m_header = nullptr;
+}
+
+std::vector<int64_t> DiNNFile::Read(size_t offset, size_t count) const {
+  std::vector<int64_t> res(count);
+  const uint8_t *src = m_data + offset;
+  switch (GetDType()) {
+    case INT8:
+      for (size_t i = 0; i < count; i++)
+        res[i] = reinterpret_cast<const int8_t *>(src)[i];
+      break;
+    case INT16:
+      for (size_t i = 0; i < count; i++)
+        res[i] = reinterpret_cast<const int16_t *>(src)[i];
+      break;
+    case INT32:
+      for (size_t i = 0; i < count; i++)
+        res[i] = reinterpret_cast<const int32_t *>(src)[i];
+      break;
+    case INT64:
+      std::memcpy(res.data(), src, count * sizeof(int64_t));
+      break;
+  }
+  return res;
+}
+
+std::vector<int64_t> DiNNFile::GetWeights(uint32_t l) const {
+  if (GetKind() != MODEL || l + 1 >= m_shape.size())
+    PALISADE_THROW(config_error, "No such layer in the DiNN file");
+  size_t dt = GetDType();
+  size_t offset = m_payload;
+  for (uint32_t i = 0; i < l; i++)
+    offset = Align8(Align8(offset + dt * m_shape[i] * m_shape[i + 1]) +
+                    dt * m_shape[i + 1]);
+  return Read(offset, size_t(m_shape[l]) * m_shape[l + 1]);
+}
+
+std::vector<int64_t> DiNNFile::GetBiases(uint32_t l) const {
+  if (GetKind() != MODEL || l + 1 >= m_shape.size())
+    PALISADE_THROW(config_error, "No such layer in the DiNN file");
+  size_t dt = GetDType();
+  size_t offset = m_payload;
+  for (uint32_t i = 0; i < l; i++)
+    offset = Align8(Align8(offset + dt * m_shape[i] * m_shape[i + 1]) +
+                    dt * m_shape[i + 1]);
+  offset = Align8(offset + dt * m_shape[l] * m_shape[l + 1]);
+  return Read(offset, m_shape[l + 1]);
+}
+
+uint32_t DiNNFile::GetNumImages() const {
+  if (GetKind() != DATASET)
+    PALISADE_THROW(config_error, "The DiNN file is not a dataset");
+  return m_shape[0];
+}
+
+uint32_t DiNNFile::GetImageSize() const {
+  if (GetKind() != DATASET)
+    PALISADE_THROW(config_error, "The DiNN file is not a dataset");
+  return m_shape[1];
+}
+
+std::vector<int64_t> DiNNFile::GetImage(uint32_t k) const {
+  if (k >= GetNumImages())
+    PALISADE_THROW(config_error, "No such image in the DiNN file");
+  size_t dt = GetDType();
+  size_t offset = Align8(m_payload + dt * m_shape[0]);
+  return Read(offset + dt * k * m_shape[1], m_shape[1]);
+}
+
+int64_t DiNNFile::GetLabel(uint32_t k) const {
+  if (k >= GetNumImages())
+    PALISADE_THROW(config_error, "No such image in the DiNN file");
+  return Read(m_payload + GetDType() * size_t(k), 1)[0];
+}
+
+// smallest type that holds all values
+static DiNNFile::DType FitDType(const std::vector<std::vector<int64_t>> &v) {
+  int64_t lo = 0;
+  int64_t hi = 0;
+  for (const auto &row : v)
+    for (auto x : row) {
+      lo = std::min(lo, x);
+      hi = std::max(hi, x);
+    }
+  if (lo >= std::numeric_limits<int8_t>::min() &&
+      hi <= std::numeric_limits<int8_t>::max())
+    return DiNNFile::INT8;
+  if (lo >= std::numeric_limits<int16_t>::min() &&
+      hi <= std::numeric_limits<int16_t>::max())
+    return DiNNFile::INT16;
+  if (lo >= std::numeric_limits<int32_t>::min() &&
+      hi <= std::numeric_limits<int32_t>::max())
+    return DiNNFile::INT32;
+  return DiNNFile::INT64;
+}
+
+// writes the values with the given width and pads to 8 bytes
+static void WriteValues(std::ofstream &out, const std::vector<int64_t> &v,
+                        DiNNFile::DType dtype) {
+  for (auto x : v) {
+    int8_t x8 = static_cast<int8_t>(x);
+    int16_t x16 = static_cast<int16_t>(x);
+    int32_t x32 = static_cast<int32_t>(x);
+    switch (dtype) {
+      case DiNNFile::INT8:
+        out.write(reinterpret_cast<const char *>(&x8), 1);
+        break;
+      case DiNNFile::INT16:
+        out.write(reinterpret_cast<const char *>(&x16), 2);
+        break;
+      case DiNNFile::INT32:
+        out.write(reinterpret_cast<const char *>(&x32), 4);
+        break;
+      case DiNNFile::INT64:
+        out.write(reinterpret_cast<const char *>(&x), 8);
+        break;
+    }
+  }
+  size_t pos = out.tellp();
+  static const char zeros[8] = {0};
+  out.write(zeros, Align8(pos) - pos);
+}
+
+static void WriteContainer(const std::string &path, DiNNFile::Kind kind,
+                           const std::vector<uint32_t> &shape,
+                           const std::vector<std::vector<int64_t>> &sections,
+                           uint64_t modulus) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open())
+    PALISADE_THROW(config_error, "Cannot write DiNN file " + path);
+
+  DiNNFile::DiNNFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, DINN_MAGIC, sizeof(DINN_MAGIC));
+  header.version = DiNNFile::VERSION;
+  header.kind = kind;
+  header.dtype = FitDType(sections);
+  header.modulus = modulus;
+  header.numDims = shape.size();
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(shape.data()),
+            4 * shape.size());
+  size_t pos = out.tellp();
+  static const char zeros[8] = {0};
+  out.write(zeros, Align8(pos) - pos);
+
+  for (const auto &section : sections)
+    WriteValues(out, section, static_cast<DiNNFile::DType>(header.dtype));
+  if (!out.good())
+    PALISADE_THROW(config_error, "Cannot write DiNN file " + path);
+}
+
+void DiNNFile::WriteModel(const std::string &path,
+                          const std::vector<uint32_t> &topology,
+                          const std::vector<std::vector<int64_t>> &weights,
+                          const std::vector<std::vector<int64_t>> &biases,
+                          uint64_t modulus) {
+  if (topology.size() < 2 || weights.size() != topology.size() - 1 ||
+      biases.size() != topology.size() - 1)
+    PALISADE_THROW(config_error,
+                   "Weights and biases do not match the network topology");
+  std::vector<std::vector<int64_t>> sections;
+  for (size_t l = 0; l + 1 < topology.size(); l++) {
+    if (weights[l].size() != size_t(topology[l]) * topology[l + 1] ||
+        biases[l].size() != topology[l + 1])
+      PALISADE_THROW(config_error,
+                     "Weights and biases do not match the network topology");
+    sections.push_back(weights[l]);
+    sections.push_back(biases[l]);
+  }
+  WriteContainer(path, MODEL, topology, sections, modulus);
+}
+
+void DiNNFile::WriteDataset(const std::string &path,
+                            const std::vector<std::vector<int64_t>> &images,
+                            const std::vector<int64_t> &labels) {
+  if (images.size() != labels.size())
+    PALISADE_THROW(config_error, "Expected one label per image");
+  uint32_t imageSize = images.empty() ? 0 : images[0].size();
+  std::vector<int64_t> pixels;
+  pixels.reserve(images.size() * imageSize);
+  for (const auto &image : images) {
+    if (image.size() != imageSize)
+      PALISADE_THROW(config_error, "All images must have the same size");
+    pixels.insert(pixels.end(), image.begin(), image.end());
+  }
+  WriteContainer(path, DATASET,
+                 {static_cast<uint32_t>(images.size()), imageSize},
+                 {labels, pixels}, 0);
+}
+
+// reads count values, one per line
+static std::vector<int64_t> ReadTextValues(std::ifstream &in, size_t count,
+                                           const std::string &path) {
+  std::vector<int64_t> v(count);
+  std::string line;
+  for (size_t i = 0; i < count; i++) {
+    if (!std::getline(in, line))
+      PALISADE_THROW(config_error, "Not enough values in " + path);
+    v[i] = std::stoll(line);
+  }
+  return v;
+}
+
+void DiNNFile::ConvertModelText(const std::string &weightsTxt,
+                                const std::string &biasesTxt,
+                                const std::vector<uint32_t> &topology,
+                                const std::string &path, uint64_t modulus) {
+  std::ifstream weightsIn(weightsTxt);
+  std::ifstream biasesIn(biasesTxt);
+  if (!weightsIn.is_open() || !biasesIn.is_open())
+    PALISADE_THROW(config_error,
+                   "Cannot open " + weightsTxt + " or " + biasesTxt);
+
+  std::vector<std::vector<int64_t>> weights;
+  std::vector<std::vector<int64_t>> biases;
+  for (size_t l = 0; l + 1 < topology.size(); l++) {
+    weights.push_back(ReadTextValues(
+        weightsIn, size_t(topology[l]) * topology[l + 1], weightsTxt));
+    biases.push_back(ReadTextValues(biasesIn, topology[l + 1], biasesTxt));
+  }
+  WriteModel(path, topology, weights, biases, modulus);
+}
+
+void DiNNFile::ConvertDatasetText(const std::string &imagesTxt,
+                                  const std::string &labelsTxt,
+                                  uint32_t numImages, uint32_t imageSize,
+                                  const std::string &path) {
+  std::ifstream imagesIn(imagesTxt);
+  std::ifstream labelsIn(labelsTxt);
+  if (!imagesIn.is_open() || !labelsIn.is_open())
+    PALISADE_THROW(config_error,
+                   "Cannot open " + imagesTxt + " or " + labelsTxt);
+
+  std::vector<std::vector<int64_t>> images(numImages);
+  for (uint32_t k = 0; k < numImages; k++)
+    images[k] = ReadTextValues(imagesIn, imageSize, imagesTxt);
+  WriteDataset(path, images, ReadTextValues(labelsIn, numImages, labelsTxt));
+}
+
+}  // namespace lbcrypto
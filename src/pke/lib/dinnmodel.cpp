@@ -0,0 +1,183 @@
+// @file dinnmodel.cpp - discretized neural network evaluated on LWE
+// ciphertexts
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "dinnmodel.h"
+
+#include "utils/stageprofiler.h"
+
+namespace lbcrypto {
+
+template <typename Element>
+EncryptedDiscretizedNet<Element>::EncryptedDiscretizedNet(
+    const CryptoContextImpl<Element> &cc, const std::vector<uint32_t> &topology,
+    const std::vector<std::vector<int64_t>> &weights,
+    const std::vector<std::vector<int64_t>> &biases, LWEPlaintextModulus p)
+    : m_cc(cc), m_topology(topology), m_biases(biases), m_p(p) {
+  if (topology.size() < 2)
+    PALISADE_THROW(config_error,
+                   "A network needs at least an input and an output layer");
+  if ((weights.size() != topology.size() - 1) ||
+      (biases.size() != topology.size() - 1))
+    PALISADE_THROW(config_error,
+                   "Weights and biases do not match the network topology");
+
+  NativeInteger q = cc.HESea_GetParams()->GetLWEParams()->Getq();
+  int64_t qInt = q.ConvertToInt();
+  int64_t pInt = p;
+
+  uint32_t numWireLayers = weights.size();
+  m_weights.resize(numWireLayers);
+  m_weightsModq.resize(numWireLayers);
+  m_biasesEnc.resize(numWireLayers);
+  for (uint32_t l = 0; l < numWireLayers; l++) {
+    uint32_t numIn = topology[l];
+    uint32_t numOut = topology[l + 1];
+    if ((weights[l].size() != (size_t)numIn * numOut) ||
+        (biases[l].size() != numOut))
+      PALISADE_THROW(config_error,
+                     "Weights and biases do not match the network topology");
+
+    // transpose from the file order (by input neuron) to rows by output neuron
+    m_weights[l].resize((size_t)numIn * numOut);
+    m_weightsModq[l] = NativeVector((size_t)numIn * numOut, q);
+    for (uint32_t j = 0; j < numOut; j++) {
+      for (uint32_t i = 0; i < numIn; i++) {
+        int64_t w = weights[l][(size_t)i * numOut + j];
+        m_weights[l][(size_t)j * numIn + i] = w;
+        m_weightsModq[l][(size_t)j * numIn + i] =
+            NativeInteger((w % qInt + qInt) % qInt);
+      }
+    }
+
+    m_biasesEnc[l].reserve(numOut);
+    for (uint32_t j = 0; j < numOut; j++)
+      m_biasesEnc[l].push_back(
+          *cc.HESea_TraivlEncrypt((biases[l][j] % pInt + pInt) % pInt, p));
+  }
+}
+
+template <typename Element>
+EncryptedDiscretizedNet<Element>::EncryptedDiscretizedNet(
+    const CryptoContextImpl<Element> &cc, const DiNNFile &file,
+    LWEPlaintextModulus p)
+    : EncryptedDiscretizedNet(cc, file.GetShape(), ReadWeights(file),
+                              ReadBiases(file), p) {
+  if (file.GetModulus() != 0 && file.GetModulus() != p)
+    PALISADE_THROW(config_error,
+                   "The model was built for a different plaintext modulus");
+}
+
+template <typename Element>
+std::vector<std::vector<int64_t>>
+EncryptedDiscretizedNet<Element>::ReadWeights(const DiNNFile &file) {
+  if (file.GetKind() != DiNNFile::MODEL)
+    PALISADE_THROW(config_error, "The DiNN file does not hold a model");
+  std::vector<std::vector<int64_t>> weights;
+  for (uint32_t l = 0; l + 1 < file.GetShape().size(); l++)
+    weights.push_back(file.GetWeights(l));
+  return weights;
+}
+
+template <typename Element>
+std::vector<std::vector<int64_t>>
+EncryptedDiscretizedNet<Element>::ReadBiases(const DiNNFile &file) {
+  if (file.GetKind() != DiNNFile::MODEL)
+    PALISADE_THROW(config_error, "The DiNN file does not hold a model");
+  std::vector<std::vector<int64_t>> biases;
+  for (uint32_t l = 0; l + 1 < file.GetShape().size(); l++)
+    biases.push_back(file.GetBiases(l));
+  return biases;
+}
+
+template <typename Element>
+std::vector<LWECiphertext> EncryptedDiscretizedNet<Element>::Infer(
+    const std::vector<LWECiphertext> &image) const {
+  return InferBatch({image})[0];
+}
+
+template <typename Element>
+std::vector<std::vector<LWECiphertext>>
+EncryptedDiscretizedNet<Element>::InferBatch(
+    const std::vector<std::vector<LWECiphertext>> &images) const {
+  for (const auto &image : images)
+    if (image.size() != m_topology[0])
+      PALISADE_THROW(config_error,
+                     "The image size does not match the input layer");
+
+  std::vector<std::vector<LWECiphertext>> layers = images;
+  uint32_t numWireLayers = m_weights.size();
+  for (uint32_t l = 0; l < numWireLayers; l++) {
+    for (auto &layer : layers) layer = EvalLinear(l, layer);
+    // the scores of the output layer are not bootstrapped
+    if (l == numWireLayers - 1) break;
+
+    uint32_t numOut = m_topology[l + 1];
+    std::vector<LWECiphertext> sums;
+    sums.reserve(layers.size() * numOut);
+    for (const auto &layer : layers)
+      sums.insert(sums.end(), layer.begin(), layer.end());
+
+    auto signs = m_cc.HESea_EvalSignBatch(sums, m_p);
+    for (size_t k = 0; k < layers.size(); k++)
+      layers[k].assign(signs.begin() + k * numOut,
+                       signs.begin() + (k + 1) * numOut);
+  }
+  return layers;
+}
+
+template <typename Element>
+std::vector<int64_t> EncryptedDiscretizedNet<Element>::InferClear(
+    const std::vector<int64_t> &image) const {
+  if (image.size() != m_topology[0])
+    PALISADE_THROW(config_error,
+                   "The image size does not match the input layer");
+
+  std::vector<int64_t> in = image;
+  uint32_t numWireLayers = m_weights.size();
+  for (uint32_t l = 0; l < numWireLayers; l++) {
+    uint32_t numIn = m_topology[l];
+    uint32_t numOut = m_topology[l + 1];
+    std::vector<int64_t> out(m_biases[l]);
+    for (uint32_t j = 0; j < numOut; j++)
+      for (uint32_t i = 0; i < numIn; i++)
+        out[j] += in[i] * m_weights[l][(size_t)j * numIn + i];
+    // hidden neurons only pass the sign of their input on
+    if (l < numWireLayers - 1)
+      for (auto &v : out) v = (v < 0) ? -1 : 1;
+    in = std::move(out);
+  }
+  return in;
+}
+
+template <typename Element>
+std::vector<LWECiphertext> EncryptedDiscretizedNet<Element>::EvalLinear(
+    uint32_t l, const std::vector<LWECiphertext> &in) const {
+  StageTimer timer("dinn.linear");
+  std::vector<LWECiphertext> out;
+  m_cc.HESea_GetLWEScheme()->EvalLWELinear(m_weightsModq[l], in,
+                                           m_biasesEnc[l], &out);
+  return out;
+}
+
+}  // namespace lbcrypto
@@ -0,0 +1,238 @@
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/*
+  Unit tests for the encrypted DiNN inference engine
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "cryptocontext.h"
+#include "dinnengine.h"
+#include "dinnfile.h"
+#include "dinnmodel.h"
+#include "dinnqueue.h"
+
+using namespace std;
+using namespace lbcrypto;
+
+class UTDiNN : public ::testing::Test {
+ protected:
+  void SetUp() {
+    cc.Generate_Default_params();
+    sk = cc.HESea_KeyGen02();
+    cc.HESea_BTKeyGen(sk);
+  }
+
+  void TearDown() {}
+
+ public:
+  // 4:3:2 network whose hidden sums stay far away from the sign threshold;
+  // weights are listed by input neuron as in the weights file
+  const vector<uint32_t> topology = {4, 3, 2};
+  const vector<vector<int64_t>> weights = {
+      {2, -3, 1, 1, 2, -4, 3, -1, 2, -2, 4, 1}, {3, -1, 2, 5, -1, 4}};
+  const vector<vector<int64_t>> biases = {{1, -2, 0}, {2, -3}};
+  const LWEPlaintextModulus p = 512;
+
+  CryptoContextImpl<DCRTPoly> cc;
+  LWEPrivateKey sk;
+
+  vector<LWECiphertext> EncryptImage(const vector<int64_t> &image) {
+    vector<LWECiphertext> ct;
+    for (auto x : image) ct.push_back(cc.HESea_Encrypt(sk, (x + p) % p, p));
+    return ct;
+  }
+
+  vector<int64_t> DecryptScores(const vector<LWECiphertext> &ct) {
+    vector<int64_t> scores;
+    for (auto &c : ct) {
+      LWEPlaintext s;
+      cc.HESea_Decrypt(sk, c, &s, p);
+      scores.push_back((s > (LWEPlaintext)p / 2) ? s - p : s);
+    }
+    return scores;
+  }
+};
+
+TEST_F(UTDiNN, Infer) {
+  EncryptedDiscretizedNet<DCRTPoly> model(cc, topology, weights, biases, p);
+
+  // hidden sums are (18, -16, 22)
+  EXPECT_EQ(vector<int64_t>({2, -5}), model.InferClear({3, -2, 5, 1}));
+  EXPECT_EQ(vector<int64_t>({2, -5}),
+            DecryptScores(model.Infer(EncryptImage({3, -2, 5, 1}))));
+}
+
+TEST_F(UTDiNN, InferBatch) {
+  // 4:3:3:2, the second hidden layer sums are (18, -18, -11)
+  vector<uint32_t> deep = {4, 3, 3, 2};
+  vector<vector<int64_t>> deepWeights = {
+      weights[0], {7, -6, 5, -4, 5, 6, 6, -7, -8}, weights[1]};
+  vector<vector<int64_t>> deepBiases = {biases[0], {1, 0, -2}, biases[1]};
+  EncryptedDiscretizedNet<DCRTPoly> model(cc, deep, deepWeights, deepBiases, p);
+
+  vector<vector<int64_t>> images = {{3, -2, 5, 1}, {-3, 2, -5, -1}};
+  auto result =
+      model.InferBatch({EncryptImage(images[0]), EncryptImage(images[1])});
+  ASSERT_EQ(2U, result.size());
+  for (size_t k = 0; k < images.size(); k++)
+    EXPECT_EQ(model.InferClear(images[k]), DecryptScores(result[k]));
+}
+
+TEST_F(UTDiNN, Run) {
+  auto model = std::make_shared<EncryptedDiscretizedNet<DCRTPoly>>(
+      cc, topology, weights, biases, p);
+  DiNNInferenceEngine<DCRTPoly> engine(model);
+
+  // the second image flips the sign of every hidden neuron
+  auto result = engine.Run(
+      {EncryptImage({3, -2, 5, 1}), EncryptImage({-3, 2, -5, -1})});
+  ASSERT_EQ(2U, result.size());
+  EXPECT_EQ(vector<int64_t>({2, -5}), DecryptScores(result[0]));
+  EXPECT_EQ(vector<int64_t>({2, -1}), DecryptScores(result[1]));
+}
+
+TEST(UTDiNNQueue, BoundedQueue) {
+  BoundedQueue<int> queue(3);
+  EXPECT_EQ(4U, queue.GetCapacity());
+  EXPECT_EQ(2U, BoundedQueue<int>(1).GetCapacity());
+  for (int i = 0; i < 4; i++) EXPECT_TRUE(queue.TryPush(int(i)));
+  EXPECT_FALSE(queue.TryPush(4));
+  int v;
+  EXPECT_TRUE(queue.TryPop(&v));
+  EXPECT_EQ(0, v);
+
+  // two producers and two consumers; every element is popped exactly once
+  const int n = 10000;
+  vector<int> seen(2 * n + 4, 0);
+  std::thread producers[2], consumers[2];
+  for (int t = 0; t < 2; t++)
+    producers[t] = std::thread([&, t]() {
+      for (int i = 0; i < n; i++) queue.Push(4 + 2 * i + t);
+    });
+  for (int t = 0; t < 2; t++)
+    consumers[t] = std::thread([&]() {
+      int x;
+      while (queue.Pop(&x)) seen[x]++;
+    });
+  for (auto &t : producers) t.join();
+  queue.Close();
+  for (auto &t : consumers) t.join();
+
+  EXPECT_FALSE(queue.Push(0));
+  EXPECT_EQ(vector<int>(2 * n + 3, 1), vector<int>(seen.begin() + 1, seen.end()));
+}
+
+TEST_F(UTDiNN, RunPipeline) {
+  auto model = std::make_shared<EncryptedDiscretizedNet<DCRTPoly>>(
+      cc, topology, weights, biases, p);
+  DiNNInferenceEngine<DCRTPoly> engine(model, 2);
+
+  vector<vector<int64_t>> images = {
+      {3, -2, 5, 1}, {-3, 2, -5, -1}, {-3, 2, -4, 1}, {0, 3, -4, 4}, {4, 0, 5, 0}};
+  vector<vector<int64_t>> scores(images.size());
+  // short queues keep the stages waiting on each other
+  size_t count = engine.RunPipeline(
+      [&](size_t k, vector<LWECiphertext> *ct) {
+        if (k >= images.size()) return false;
+        *ct = EncryptImage(images[k]);
+        return true;
+      },
+      [&](size_t k, const vector<LWECiphertext> &ct) {
+        scores[k] = DecryptScores(ct);
+      },
+      1);
+  EXPECT_EQ(images.size(), count);
+  for (size_t k = 0; k < images.size(); k++)
+    EXPECT_EQ(model->InferClear(images[k]), scores[k]);
+
+  // an error in any stage stops the pipeline and is passed to the caller
+  EXPECT_THROW(engine.RunPipeline(
+                   [&](size_t k, vector<LWECiphertext> *ct) {
+                     *ct = EncryptImage({1, 2, 3});
+                     return true;
+                   },
+                   [&](size_t k, const vector<LWECiphertext> &ct) {}),
+               config_error);
+}
+
+TEST_F(UTDiNN, Topology) {
+  EXPECT_THROW(
+      EncryptedDiscretizedNet<DCRTPoly>(cc, {4, 3}, weights, biases, p),
+      config_error);
+  EXPECT_THROW(
+      EncryptedDiscretizedNet<DCRTPoly>(cc, {4, 2, 2}, weights, biases, p),
+      config_error);
+
+  EncryptedDiscretizedNet<DCRTPoly> model(cc, topology, weights, biases, p);
+  EXPECT_THROW(model.Infer(EncryptImage({1, 2, 3})), config_error);
+}
+
+TEST_F(UTDiNN, File) {
+  const string modelFile = "UTDiNN-model.dinn";
+  const string datasetFile = "UTDiNN-dataset.dinn";
+
+  DiNNFile::WriteModel(modelFile, topology, weights, biases, p);
+  {
+    DiNNFile file(modelFile);
+    EXPECT_EQ(DiNNFile::MODEL, file.GetKind());
+    EXPECT_EQ(DiNNFile::INT8, file.GetDType());
+    EXPECT_EQ(p, file.GetModulus());
+    EXPECT_EQ(topology, file.GetShape());
+    EXPECT_EQ(weights[1], file.GetWeights(1));
+    EXPECT_EQ(biases[0], file.GetBiases(0));
+
+    EncryptedDiscretizedNet<DCRTPoly> model(cc, file, p);
+    EXPECT_EQ(topology, model.GetTopology());
+    EXPECT_EQ(vector<int64_t>({2, -5}), model.InferClear({3, -2, 5, 1}));
+    EXPECT_THROW(EncryptedDiscretizedNet<DCRTPoly>(cc, file, 1024),
+                 config_error);
+  }
+
+  vector<vector<int64_t>> images = {{3, -2, 5, 1}, {-3, 2, -5, 1000}};
+  DiNNFile::WriteDataset(datasetFile, images, {7, 1});
+  {
+    DiNNFile file(datasetFile);
+    EXPECT_EQ(DiNNFile::DATASET, file.GetKind());
+    EXPECT_EQ(DiNNFile::INT16, file.GetDType());
+    EXPECT_EQ(2U, file.GetNumImages());
+    EXPECT_EQ(4U, file.GetImageSize());
+    EXPECT_EQ(images[1], file.GetImage(1));
+    EXPECT_EQ(7, file.GetLabel(0));
+    EXPECT_THROW(file.GetWeights(0), config_error);
+  }
+
+  // a file without the magic is rejected
+  {
+    std::fstream f(datasetFile, ios::in | ios::out | ios::binary);
+    f.write("NNiD", 4);
+  }
+  EXPECT_THROW(DiNNFile file(datasetFile), deserialize_error);
+
+  std::remove(modelFile.c_str());
+  std::remove(datasetFile.c_str());
+}
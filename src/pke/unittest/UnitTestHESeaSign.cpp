@@ -0,0 +1,241 @@
+// @author TPOC: contact@palisade-crypto.org
+//
+// @copyright Copyright (c) 2019, New Jersey Institute of Technology (NJIT)
+// All rights reserved.
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution. THIS SOFTWARE IS
+// PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+// IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+// EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+// INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/*
+  Unit tests for the sign function bootstrapping used by DiNN inference
+ */
+
+#include <algorithm>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "cryptocontext.h"
+
+using namespace std;
+using namespace lbcrypto;
+
+// Checks that the batched sign evaluation matches the single-ciphertext one
+TEST(UnitTestHESeaSign, EvalSignBatch) {
+  auto cc = CryptoContextImpl<DCRTPoly>();
+  cc.Generate_Default_params();
+
+  auto sk = cc.HESea_KeyGen02();
+  cc.HESea_BTKeyGen(sk);
+
+  LWEPlaintextModulus p = 512;
+  vector<LWEPlaintext> inputs = {10, 64, 100, 200, -10, -64, -100, -200};
+
+  vector<LWECiphertext> cts;
+  for (auto x : inputs) cts.push_back(cc.HESea_Encrypt(sk, (x + p) % p, p));
+
+  auto batch = cc.HESea_EvalSignBatch(cts, p);
+  ASSERT_EQ(cts.size(), batch.size());
+
+  for (size_t i = 0; i < cts.size(); i++) {
+    auto single = cc.HESea_MyEvalSigndFunc(cts[i], p);
+    EXPECT_EQ(*single, *batch[i]) << "Batched sign differs at input " << i;
+
+    LWEPlaintext result;
+    cc.HESea_Decrypt(sk, batch[i], &result, p);
+    LWEPlaintext expected = (inputs[i] >= 0) ? 1 : p - 1;
+    EXPECT_EQ(expected, result) << "Sign failed for input " << inputs[i];
+  }
+
+  EXPECT_EQ(0U, cc.HESea_EvalSignBatch({}, p).size());
+}
+
+// Checks that a bootstrapping split across threads gives the same
+// ciphertext as one on the calling thread
+TEST(UnitTestHESeaSign, BootstrapThreads) {
+  auto cc = CryptoContextImpl<DCRTPoly>();
+  cc.Generate_Default_params();
+
+  auto sk = cc.HESea_KeyGen02();
+  cc.HESea_BTKeyGen(sk);
+
+  LWEPlaintextModulus p = 512;
+  vector<LWECiphertext> cts;
+  for (auto x : {37, -37}) cts.push_back(cc.HESea_Encrypt(sk, (x + p) % p, p));
+  auto LUT = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [](LWEPlaintext m) { return m / 2; }, 16);
+
+  vector<LWECiphertext> serial;
+  for (auto &ct : cts) {
+    serial.push_back(cc.HESea_MyEvalSigndFunc(ct, p));
+    serial.push_back(cc.HESea_EvalFunc(ct, LUT, 16));
+  }
+
+  auto scheme = cc.HESea_GetRingGSWScheme();
+  for (uint32_t threads : {2U, 3U}) {
+    cc.HESea_SetBootstrapThreads(threads);
+    // the team is capped at the number of hardware threads
+    EXPECT_GE(threads, scheme->GetBootstrapThreads());
+    for (size_t i = 0; i < cts.size(); i++) {
+      EXPECT_EQ(*serial[2 * i], *cc.HESea_MyEvalSigndFunc(cts[i], p))
+          << "Sign with " << threads << " threads differs at input " << i;
+      EXPECT_EQ(*serial[2 * i + 1], *cc.HESea_EvalFunc(cts[i], LUT, 16))
+          << "EvalFunc with " << threads << " threads differs at input " << i;
+    }
+  }
+  cc.HESea_SetBootstrapThreads(1);
+  EXPECT_EQ(1U, scheme->GetBootstrapThreads());
+}
+
+// Programmable bootstrapping with a negacyclic table over all of Z_p and
+// with tables restricted to the lower half of Z_p
+TEST(UnitTestHESeaSign, EvalFunc) {
+  auto cc = CryptoContextImpl<DCRTPoly>();
+  cc.Generate_Default_params();
+
+  auto sk = cc.HESea_KeyGen02();
+  cc.HESea_BTKeyGen(sk);
+
+  LWEPlaintextModulus p = 16;
+  auto check = [&](const vector<LWEPlaintext> &LUT, LWEPlaintext maxInput) {
+    for (LWEPlaintext m = 0; m < maxInput; m++) {
+      auto ct = cc.HESea_EvalFunc(cc.HESea_Encrypt(sk, m, p), LUT, p);
+      LWEPlaintext result;
+      cc.HESea_Decrypt(sk, ct, &result, p);
+      EXPECT_EQ(LUT[m], result) << "EvalFunc failed for input " << m;
+    }
+  };
+
+  // LUT[m + p/2] = -LUT[m]
+  auto negacyclic = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [&](LWEPlaintext m) {
+        return (m < (LWEPlaintext)p / 2) ? 2 * m + 1 : -(2 * (m - p / 2) + 1);
+      },
+      p);
+  check(negacyclic, p);
+
+  // ReLU of x in [-p/4, p/4), encrypted as x + p/4
+  auto relu = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [&](LWEPlaintext m) { return std::max<LWEPlaintext>(m - p / 4, 0); },
+      p);
+  check(relu, p / 2);
+
+  auto square = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [](LWEPlaintext m) { return m * m; }, p);
+  check(square, p / 2);
+
+  // the cached test vector is the one of the table
+  auto params = cc.HESea_GetParams();
+  auto scheme = cc.HESea_GetRingGSWScheme();
+  EXPECT_EQ(scheme->GetTestVector(params, relu, p),
+            scheme->GetTestVector(params, relu, p));
+  EXPECT_NE(scheme->GetTestVector(params, relu, p),
+            scheme->GetTestVector(params, square, p));
+  EXPECT_THROW(cc.HESea_EvalFunc(cc.HESea_Encrypt(sk, 1, p), relu, 8),
+               config_error);
+}
+
+// Multi-value bootstrapping gives the outputs of EvalFunc for every table
+TEST(UnitTestHESeaSign, EvalMultiFunc) {
+  auto cc = CryptoContextImpl<DCRTPoly>();
+  cc.Generate_Default_params();
+
+  auto sk = cc.HESea_KeyGen02();
+  cc.HESea_BTKeyGen(sk);
+
+  LWEPlaintextModulus p = 16;
+  auto check = [&](const vector<vector<LWEPlaintext>> &LUTs,
+                   LWEPlaintext maxInput) {
+    for (LWEPlaintext m = 0; m < maxInput; m++) {
+      auto cts = cc.HESea_EvalMultiFunc(cc.HESea_Encrypt(sk, m, p), LUTs, p);
+      ASSERT_EQ(LUTs.size(), cts.size());
+      for (size_t k = 0; k < LUTs.size(); k++) {
+        LWEPlaintext result;
+        cc.HESea_Decrypt(sk, cts[k], &result, p);
+        EXPECT_EQ(LUTs[k][m], result)
+            << "EvalMultiFunc failed for table " << k << " and input " << m;
+      }
+    }
+  };
+
+  // LUT[m + p/2] = -LUT[m]
+  auto negacyclic = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [&](LWEPlaintext m) {
+        return (m < (LWEPlaintext)p / 2) ? 2 * m + 1 : -(2 * (m - p / 2) + 1);
+      },
+      p);
+  check({negacyclic}, p);
+
+  // sign, ReLU and clipping of x in [-p/4, p/4), encrypted as x + p/4
+  auto sign = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [&](LWEPlaintext m) { return (m >= (LWEPlaintext)p / 4) ? 1 : -1; }, p);
+  auto relu = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [&](LWEPlaintext m) { return std::max<LWEPlaintext>(m - p / 4, 0); },
+      p);
+  auto clip = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [&](LWEPlaintext m) {
+        return std::min<LWEPlaintext>(std::max<LWEPlaintext>(m - p / 4, -2),
+                                      2);
+      },
+      p);
+  check({sign, relu, clip, negacyclic}, p / 2);
+
+  EXPECT_EQ(0U, cc.HESea_EvalMultiFunc(cc.HESea_Encrypt(sk, 1, p), {}, p)
+                    .size());
+  EXPECT_THROW(cc.HESea_EvalMultiFunc(cc.HESea_Encrypt(sk, 1, p), {relu}, 8),
+               config_error);
+}
+
+// The GINX monomials applied as rotations give the same ciphertexts as the
+// precomputed monomials
+TEST(UnitTestHESeaSign, GINXRotation) {
+  auto cc = CryptoContextImpl<DCRTPoly>();
+  cc.Generate_Default_params();
+
+  auto sk = cc.HESea_KeyGen02();
+  cc.HESea_BTKeyGen(sk);
+
+  LWEPlaintextModulus p = 512;
+  vector<LWECiphertext> cts;
+  for (auto x : {37, -37}) cts.push_back(cc.HESea_Encrypt(sk, (x + p) % p, p));
+  auto LUT = CryptoContextImpl<DCRTPoly>::HESea_GenerateLUTviaFunction(
+      [](LWEPlaintext m) { return m / 2; }, 16);
+
+  auto scheme = cc.HESea_GetRingGSWScheme();
+  EXPECT_FALSE(scheme->GetGINXRotation());
+  vector<LWECiphertext> table;
+  for (auto &ct : cts) {
+    table.push_back(cc.HESea_MyEvalSigndFunc(ct, p));
+    table.push_back(cc.HESea_EvalFunc(ct, LUT, 16));
+    table.push_back(cc.HESea_EvalMultiFunc(ct, {LUT}, 16)[0]);
+  }
+
+  scheme->SetGINXRotation(true);
+  EXPECT_TRUE(scheme->GetGINXRotation());
+  for (size_t i = 0; i < cts.size(); i++) {
+    EXPECT_EQ(*table[3 * i], *cc.HESea_MyEvalSigndFunc(cts[i], p))
+        << "Sign with rotations differs at input " << i;
+    EXPECT_EQ(*table[3 * i + 1], *cc.HESea_EvalFunc(cts[i], LUT, 16))
+        << "EvalFunc with rotations differs at input " << i;
+    EXPECT_EQ(*table[3 * i + 2], *cc.HESea_EvalMultiFunc(cts[i], {LUT}, 16)[0])
+        << "EvalMultiFunc with rotations differs at input " << i;
+  }
+  auto batch = cc.HESea_EvalSignBatch(cts, p);
+  for (size_t i = 0; i < cts.size(); i++)
+    EXPECT_EQ(*table[3 * i], *batch[i])
+        << "Batched sign with rotations differs at input " << i;
+  scheme->SetGINXRotation(false);
+}